@@ -133,8 +133,8 @@ void parallel_bit_array_set_bit(BIT_ARRAY* bitarr, bit_index_t b) {
   } else {
     // out of bounds error
     fprintf(stderr, "bit_array.c: bit_array_set_bit() - "
-            "out of bounds error (index: %u; length: %u)\n",
-            b, bitarr->num_of_bits);
+            "out of bounds error (index: %lu; length: %lu)\n",
+            (unsigned long)b, (unsigned long)bitarr->num_of_bits);
 
     errno = EDOM;
 
@@ -156,8 +156,8 @@ void parallel_or_bit_array_set_bit(BIT_ARRAY* bitarr, bit_index_t b) {
   } else {
     // out of bounds error
     fprintf(stderr, "bit_array.c: bit_array_set_bit() - "
-            "out of bounds error (index: %u; length: %u)\n",
-            b, bitarr->num_of_bits);
+            "out of bounds error (index: %lu; length: %lu)\n",
+            (unsigned long)b, (unsigned long)bitarr->num_of_bits);
 
     errno = EDOM;
 
@@ -172,8 +172,8 @@ void bit_array_set_bit(BIT_ARRAY* bitarr, bit_index_t b) {
   } else {
     // out of bounds error
     fprintf(stderr, "bit_array.c: bit_array_set_bit() - "
-            "out of bounds error (index: %u; length: %u)\n",
-            b, bitarr->num_of_bits);
+            "out of bounds error (index: %lu; length: %lu)\n",
+            (unsigned long)b, (unsigned long)bitarr->num_of_bits);
 
     errno = EDOM;
 
@@ -189,8 +189,8 @@ void bit_array_clear_bit(BIT_ARRAY* bitarr, bit_index_t b) {
   } else {
     // out of bounds error
     fprintf(stderr, "bit_array.c: bit_array_clear_bit() - "
-            "out of bounds error (index: %u; length: %u)\n",
-            b, bitarr->num_of_bits);
+            "out of bounds error (index: %lu; length: %lu)\n",
+            (unsigned long)b, (unsigned long)bitarr->num_of_bits);
 
     errno = EDOM;
 
@@ -213,8 +213,8 @@ char bit_array_get_bit(BIT_ARRAY* bitarr, bit_index_t b) {
   } else {
     // out of bounds error
     fprintf(stderr, "bit_array.c: bit_array_get_bit() - "
-            "out of bounds error (index: %u; length: %u)\n",
-            b, bitarr->num_of_bits);
+            "out of bounds error (index: %lu; length: %lu)\n",
+            (unsigned long)b, (unsigned long)bitarr->num_of_bits);
 
     errno = EDOM;
 
@@ -544,7 +544,7 @@ char bit_array_decrement(BIT_ARRAY* bitarr) {
 
       i--;
       while(i >= 0) {
-        bitarr->words[i--] = (unsigned int) ULONG_MAX;
+        bitarr->words[i--] = (word_t) ULONG_MAX;
       }
 
       return 1;
@@ -570,7 +570,8 @@ long bit_array_get_long(BIT_ARRAY* bitarr, bit_index_t start) {
   // Bounds checking
   if(start >= bitarr->num_of_bits) {
     fprintf(stderr, "bit_array.c: bit_array_get_long() - out of bounds error "
-            "(index: %u, length: %u)\n", start, bitarr->num_of_bits);
+            "(index: %lu, length: %lu)\n", (unsigned long)start,
+            (unsigned long)bitarr->num_of_bits);
     exit(EXIT_FAILURE);
   }
 
@@ -596,7 +597,8 @@ int bit_array_get_int(BIT_ARRAY* bitarr, bit_index_t start) {
   // Bounds checking
   if(start >= bitarr->num_of_bits) {
     fprintf(stderr, "bit_array.c: bit_array_get_long() - out of bounds error "
-            "(index: %u, length: %u)\n", start, bitarr->num_of_bits);
+            "(index: %lu, length: %lu)\n", (unsigned long)start,
+            (unsigned long)bitarr->num_of_bits);
     exit(EXIT_FAILURE);
   }
 
@@ -623,7 +625,8 @@ char bit_array_get_char(BIT_ARRAY* bitarr, bit_index_t start) {
   // Bounds checking
   if(start >= bitarr->num_of_bits) {
     fprintf(stderr, "bit_array.c: bit_array_get_long() - out of bounds error "
-            "(index: %u, length: %u)\n", start, bitarr->num_of_bits);
+            "(index: %lu, length: %lu)\n", (unsigned long)start,
+            (unsigned long)bitarr->num_of_bits);
     exit(EXIT_FAILURE);
   }
 
@@ -644,7 +647,7 @@ void bit_array_save(BIT_ARRAY* bitarr, FILE* f) {
 
   fwrite(&num_of_bytes, sizeof(size_t), 1, f);
 
-  fwrite(&bitarr->num_of_bits, sizeof(unsigned int), 1, f);
+  fwrite(&bitarr->num_of_bits, sizeof(bit_index_t), 1, f);
 
   fwrite(bitarr->words, sizeof(word_t), num_of_bytes, f);
 
@@ -662,7 +665,7 @@ BIT_ARRAY* bit_array_load(FILE* f) {
 
   bitarr->words = malloc(sizeof(word_t) * num_of_bytes);
 
-  x = fread(&bitarr->num_of_bits, sizeof(unsigned int), 1, f);
+  x = fread(&bitarr->num_of_bits, sizeof(bit_index_t), 1, f);
 
   x = fread(bitarr->words, sizeof(word_t), num_of_bytes, f);
 
@@ -703,9 +706,9 @@ void bit_array_concat_slow(BIT_ARRAY* dest, BIT_ARRAY* from) {
 
 
 void bit_array_concat(BIT_ARRAY* dest, BIT_ARRAY* from) {
-  unsigned int count, corr, desp;
-  unsigned int nwords_old, nwords_new;
-  unsigned int newsize;
+  unsigned int corr, desp;
+  word_addr_t count, nwords_old, nwords_new;
+  bit_index_t newsize;
 
   word_t* d;
   word_t* f;
@@ -36,19 +36,29 @@
 #define BIT_ARRAY_HEADER_SEEN
 
 #include<stdio.h>
+#include<stdint.h>
 
-// 64 bit
-//typedef unsigned long word_t, word_addr_t, bit_index_t;
-// 32 bit
-typedef unsigned int word_t, word_addr_t, bit_index_t;
+// Machine words are 64-bit with -DARCH64 and 32-bit otherwise
+#ifdef ARCH64
+typedef uint64_t word_t;
+#else
+typedef uint32_t word_t;
+#endif
+
+// Bit positions are 32-bit by default. Compile with -DIDX64 to support bit
+// arrays with more than 2^32 bits
+#ifdef IDX64
+typedef uint64_t word_addr_t, bit_index_t;
+#else
+typedef uint32_t word_addr_t, bit_index_t;
+#endif
 
 #define word_size sizeof(word_t)*8
 #define word_size_1 word_size-1
 
 struct BIT_ARRAY {
   word_t* words;
-  word_t num_of_bits;
-//  unsigned int num_of_bits;
+  bit_index_t num_of_bits;
 };
 
 
@@ -1,22 +1,57 @@
 #!bin/bash
 
-DEFS_SEQ="-std=gnu99 -DARCH64 -ffast-math -DNOPARALLEL -DEXTRA"
-DEFS_PAR="-std=gnu99 -DARCH64 -ffast-math -DEXTRA"
-DEFS_MEM="-std=gnu99 -DARCH64 -ffast-math -DNOPARALLEL -DEXTRA -DMALLOC_COUNT"
+# Parallel backends (see parallel.h):
+#   -DNOPARALLEL  sequential
+#   (default)     OpenMP, requires -fopenmp
+#   -DWSPOOL      built-in work-stealing thread pool, requires -pthread
+#   -DCILKPLUS    Cilk Plus, requires -fcilkplus -lcilkrts (GCC < 8)
+#
+# Indices are 32-bit by default. Run 'IDX64=1 bash build.sh' to build with
+# 64-bit indices (graphs whose succinct representation has more than 2^31 bits)
+IDX=${IDX64:+-DIDX64}
 
-gcc -O2 -c bit_array.c
+# Chunk size and arity of the range min-max tree (256 and 8 by default), e.g.
+# 'RMMT_S=512 RMMT_K=2 bash build.sh'. Run 'RMMT_BLOCKS=1 bash build.sh' to
+# store each chunk together with its excess values in a 64-byte block
+RMMT="${RMMT_S:+-DRMMT_S=$RMMT_S} ${RMMT_K:+-DRMMT_K=$RMMT_K} ${RMMT_BLOCKS:+-DRMMT_BLOCKS}"
+
+# Run 'LOOKUP16=1 bash build.sh' to add the 16-bit lookup tables (see
+# lookup_tables.h)
+RMMT="$RMMT ${LOOKUP16:+-DLOOKUP16}"
+
+# Run 'PIONEERS=1 bash build.sh' to add the pioneers to S2 and S3, so find_close
+# jumps directly to the chunk of a distant match (see st_build_pioneers)
+RMMT="$RMMT ${PIONEERS:+-DPIONEERS}"
+
+DEFS_SEQ="-std=gnu99 $IDX $RMMT -DARCH64 -ffast-math -DNOPARALLEL -DEXTRA"
+DEFS_PAR="-std=gnu99 $IDX $RMMT -DARCH64 -ffast-math -DEXTRA -fopenmp"
+DEFS_WS="-std=gnu99 $IDX $RMMT -DARCH64 -ffast-math -DEXTRA -DWSPOOL -pthread"
+DEFS_MEM="-std=gnu99 $IDX $RMMT -DARCH64 -ffast-math -DNOPARALLEL -DEXTRA -DMALLOC_COUNT"
+
+gcc -O2 $IDX -DARCH64 -c bit_array.c
+
+echo "Generating lookup tables ..."
+gcc -O2 -std=gnu99 $IDX $RMMT -DARCH64 -DNOPARALLEL -o gen_lookup_tables \
+gen_lookup_tables.c lookup_tables.c
+./gen_lookup_tables > lookup_tables_data.c || exit 1
 
 echo "Compiling sequential algorithm ..."
-gcc -O2 -o sg_seq $DEFS_SEQ main.c util.c defs.c bit_array.o \
-parallel_succinct_graph.c succinct_tree.c lookup_tables.c -lrt -lm
+gcc -O2 -o sg_seq $DEFS_SEQ main.c util.c defs.c parallel.c bit_array.o \
+canonical_ordering.c parallel_succinct_graph.c succinct_tree.c \
+lookup_tables_data.c -lrt -lm
 
 echo "Compiling parallel algorithm ..."
-gcc -O2 -o sg_par $DEFS_PAR main.c util.c defs.c bit_array.o \
-parallel_succinct_graph.c succinct_tree.c lookup_tables.c -fcilkplus -lcilkrts \
--lrt -lm 
+gcc -O2 -o sg_par $DEFS_PAR main.c util.c defs.c parallel.c bit_array.o \
+canonical_ordering.c parallel_succinct_graph.c succinct_tree.c \
+lookup_tables_data.c -lrt -lm
+
+echo "Compiling parallel algorithm (Work-stealing pool) ..."
+gcc -O2 -o sg_ws $DEFS_WS main.c util.c defs.c parallel.c bit_array.o \
+canonical_ordering.c parallel_succinct_graph.c succinct_tree.c \
+lookup_tables_data.c -lrt -lm
 
 echo "Compiling sequential algorithm (Working space) ..."
 gcc -c malloc_count.c
-gcc -O2 -std=gnu99 -o sg_mem $DEFS_MEM main.c util.c defs.c bit_array.o \
-malloc_count.o parallel_succinct_graph.c succinct_tree.c lookup_tables.c -lrt \
--lm -ldl
+gcc -O2 -std=gnu99 -o sg_mem $DEFS_MEM main.c util.c defs.c parallel.c \
+bit_array.o malloc_count.o canonical_ordering.c parallel_succinct_graph.c \
+succinct_tree.c lookup_tables_data.c -lrt -lm -ldl
@@ -0,0 +1,562 @@
+/******************************************************************************
+ * canonical_ordering.c
+ *
+ * Parallel construction of succinct triangulated plane graphs
+ * For more information: http://thesis.josefuentes.cl
+ *
+ ******************************************************************************
+ * Copyright (C) 2016 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "defs.h"
+
+static void not_a_triangulation() {
+  fprintf(stderr, "Error: The graph is not a plane triangulation with outer \
+face (v1, v2, vn)\n");
+  exit(EXIT_FAILURE);
+}
+
+// Below this number of candidates the shelling goes on sequentially. A round
+// does several times the work of the sequential shelling per removed vertex,
+// so it needs many candidates to pay off
+#define CO_PARALLEL_MIN 4096
+
+// Owner of a vertex that nobody claimed
+#define CO_FREE ((idx_t)-1)
+
+// Data shared by the parallel loops of canonical_ordering
+struct co_args {
+  Graph* g;
+  idx_t* co;
+  idx_t* cprev; // Previous vertex in the contour
+  idx_t* cnext; // Next vertex in the contour
+  idx_t* chords; // Chords incident to a contour vertex
+  char* state; // 0: inner, 1: contour, 2: removed, 3: entered the contour
+	       // in the current round
+  idx_t* owner; // Smallest priority that claimed a vertex in the round
+  idx_t* cand; // Candidates of the round
+  idx_t* next; // Candidates of the next round
+  idx_t* removed; // Vertices removed in the round
+  idx_t* sel; // Prefix sum of the selected candidates
+  idx_t* ret; // Prefix sum of the candidates kept for the next round
+  idx_t* cnt; // Prefix sum of the candidates pushed by each removal
+  idx_t v1, v2;
+  idx_t k; // Order of the first vertex removed in the round
+  idx_t kept; // Number of candidates kept for the next round
+};
+
+static void co_init(long i, void* arg) {
+  struct co_args* a = arg;
+  a->chords[i] = 0;
+  a->state[i] = 0;
+  a->owner[i] = CO_FREE;
+}
+
+// A vertex can be removed if it is a contour vertex without incident chords
+static inline int co_removable(struct co_args* a, idx_t v) {
+  return a->state[v] == 1 && a->chords[v] == 0 && v != a->v1 && v != a->v2;
+}
+
+// Priority of a candidate, a bijection of the vertex number. The vertex
+// numbers of neighbors are often close, and using them as priorities would
+// leave a single winner in a run of candidates
+static inline idx_t co_priority(idx_t v) {
+#ifdef IDX64
+  v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+  return v ^ (v >> 31);
+#else
+  v = (v ^ (v >> 16)) * 0x45d9f3bU;
+  v = (v ^ (v >> 16)) * 0x45d9f3bU;
+  return v ^ (v >> 16);
+#endif
+}
+
+static inline void co_claim(idx_t* owner, idx_t v, idx_t p) {
+  idx_t old = __atomic_load_n(&owner[v], __ATOMIC_RELAXED);
+  while(p < old && !__atomic_compare_exchange_n(&owner[v], &old, p, 0,
+						__ATOMIC_SEQ_CST,
+						__ATOMIC_SEQ_CST));
+}
+
+// Each removable candidate claims itself and its neighbors not yet removed
+static void co_claim_nbrs(long i, void* arg) {
+  struct co_args* a = arg;
+  idx_t c = a->cand[i];
+  if(!co_removable(a, c))
+    return;
+
+  Vertex u = a->g->V[c];
+  idx_t p = co_priority(c);
+  co_claim(a->owner, c, p);
+  for(idx_t e = u.first; e <= u.last; e++)
+    if(a->state[a->g->E[e].tgt] != 2)
+      co_claim(a->owner, a->g->E[e].tgt, p);
+}
+
+// A candidate is selected if it won all its claims. The others that are
+// still removable are kept for the next round
+static void co_select(long i, void* arg) {
+  struct co_args* a = arg;
+  idx_t c = a->cand[i];
+  a->sel[i] = a->ret[i] = 0;
+  if(!co_removable(a, c))
+    return;
+
+  Vertex u = a->g->V[c];
+  idx_t p = co_priority(c);
+  int won = (a->owner[c] == p);
+  for(idx_t e = u.first; won && e <= u.last; e++)
+    if(a->state[a->g->E[e].tgt] != 2)
+      won = (a->owner[a->g->E[e].tgt] == p);
+  a->sel[i] = won;
+  a->ret[i] = !won;
+}
+
+// Move the selected candidates to the removed ones and give them their order
+static void co_compact(long i, void* arg) {
+  struct co_args* a = arg;
+  idx_t c = a->cand[i];
+  idx_t s = (i == 0) ? 0 : a->sel[i-1];
+  idx_t r = (i == 0) ? 0 : a->ret[i-1];
+
+  if(a->sel[i] != s) {
+    a->removed[s] = c;
+    a->co[c] = a->k - s;
+  }
+  else if(a->ret[i] != r)
+    a->next[r] = c;
+  else
+    return;
+
+  Vertex u = a->g->V[c];
+  __atomic_store_n(&a->owner[c], CO_FREE, __ATOMIC_RELAXED);
+  for(idx_t e = u.first; e <= u.last; e++)
+    if(a->state[a->g->E[e].tgt] != 2)
+      __atomic_store_n(&a->owner[a->g->E[e].tgt], CO_FREE, __ATOMIC_RELAXED);
+}
+
+// The parallel rounds update the chord counters with atomic operations
+static inline void co_add(idx_t* x, idx_t d, int atomic) {
+  if(atomic)
+    __sync_add_and_fetch(x, d);
+  else
+    *x += d;
+}
+
+// Remove the vertex vk from the contour. The neighbors between its contour
+// neighbors (in ccw order) enter the contour, from left to right. It returns
+// the number of vertices that may become removable
+static inline idx_t co_remove_vertex(struct co_args* a, idx_t vk, int atomic) {
+  Graph* g = a->g;
+  idx_t l = a->cprev[vk], r = a->cnext[vk];
+  Vertex v = g->V[vk];
+  a->state[vk] = 2;
+
+  idx_t e = v.first;
+  while(e <= v.last && g->E[e].tgt != l)
+    e++;
+  if(e > v.last)
+    not_a_triangulation();
+
+  idx_t last = l, steps = 0;
+  e = (e == v.last) ? v.first : e+1;
+  while(g->E[e].tgt != r) {
+    idx_t w = g->E[e].tgt;
+    if(a->state[w] != 0 || ++steps > v.last-v.first)
+      not_a_triangulation();
+    a->cnext[last] = w; a->cprev[w] = last;
+    a->state[w] = 3;
+    last = w;
+    e = (e == v.last) ? v.first : e+1;
+  }
+  a->cnext[last] = r; a->cprev[r] = last;
+
+  if(steps > 0)
+    return steps;
+
+  // The chord (l,r) is now a contour edge
+  co_add(&a->chords[l], (idx_t)-1, atomic);
+  co_add(&a->chords[r], (idx_t)-1, atomic);
+  return 2;
+}
+
+// Count the chords of the vertices that entered the contour when vk was
+// removed. A chord between two of them is counted by its larger end
+static inline void co_count_vertex(struct co_args* a, idx_t vk, int atomic) {
+  Graph* g = a->g;
+  idx_t r = a->cnext[vk];
+
+  for(idx_t w = a->cnext[a->cprev[vk]]; w != r; w = a->cnext[w]) {
+    Vertex u = g->V[w];
+    for(idx_t e = u.first; e <= u.last; e++) {
+      idx_t x = g->E[e].tgt;
+      if((a->state[x] == 1 || (a->state[x] == 3 && x < w)) &&
+	 x != a->cprev[w] && x != a->cnext[w]) {
+	co_add(&a->chords[w], 1, atomic);
+	co_add(&a->chords[x], 1, atomic);
+      }
+    }
+  }
+}
+
+// The vertices that became removable when vk was removed are written to P:
+// the ends of the chord that became a contour edge, or the vertices that
+// entered the contour. It returns how many were written
+static inline idx_t co_push_vertex(struct co_args* a, idx_t vk, idx_t* P) {
+  idx_t l = a->cprev[vk], r = a->cnext[vk];
+  idx_t m = 0;
+
+  if(a->cnext[l] == r) {
+    if(co_removable(a, l))
+      P[m++] = l;
+    if(co_removable(a, r))
+      P[m++] = r;
+    return m;
+  }
+
+  for(idx_t w = a->cnext[l]; w != r; w = a->cnext[w]) {
+    a->state[w] = 1;
+    if(a->chords[w] == 0)
+      P[m++] = w;
+  }
+  return m;
+}
+
+static void co_remove(long j, void* arg) {
+  struct co_args* a = arg;
+  a->cnt[j] = co_remove_vertex(a, a->removed[j], 1);
+}
+
+static void co_count_chords(long j, void* arg) {
+  struct co_args* a = arg;
+  co_count_vertex(a, a->removed[j], 1);
+}
+
+// The entries of the removal j that are not used are set to v1, which is
+// never removable
+static void co_push(long j, void* arg) {
+  struct co_args* a = arg;
+  idx_t p = a->kept + ((j == 0) ? 0 : a->cnt[j-1]);
+  idx_t q = a->kept + a->cnt[j];
+
+  p += co_push_vertex(a, a->removed[j], a->next + p);
+  for(; p < q; p++)
+    a->next[p] = a->v1;
+}
+
+// It removes from the first nc candidates the ones that are not removable and
+// the repeated ones, and it returns how many are left
+static idx_t co_pending(struct co_args* a, idx_t nc) {
+  idx_t m = 0;
+
+  // The owners are free between rounds, so they mark the candidates
+  for(idx_t i = 0; i < nc; i++) {
+    idx_t c = a->cand[i];
+    if(co_removable(a, c) && a->owner[c] != c) {
+      a->owner[c] = c;
+      a->cand[m++] = c;
+    }
+  }
+  for(idx_t i = 0; i < m; i++)
+    a->owner[a->cand[i]] = CO_FREE;
+
+  return m;
+}
+
+/*
+Sequential shelling, while there are few candidates. They are kept in a stack
+(the candidates of the round), where each removal pushes the vertices that
+became removable. Entries that are no longer removable are skipped. When the stack grows
+to 2*CO_PARALLEL_MIN entries they are filtered, and if CO_PARALLEL_MIN or more
+are left it stops. It returns the number of candidates.
+*/
+static idx_t co_shell(struct co_args* a, idx_t nc) {
+  while(nc > 0 && a->k >= 2) {
+    if(nc >= 2*CO_PARALLEL_MIN) {
+      nc = co_pending(a, nc);
+      if(nc >= CO_PARALLEL_MIN)
+	break;
+      continue;
+    }
+
+    idx_t c = a->cand[--nc];
+    if(!co_removable(a, c))
+      continue;
+
+    a->co[c] = a->k--;
+    co_remove_vertex(a, c, 0);
+    co_count_vertex(a, c, 0);
+    nc += co_push_vertex(a, c, a->cand + nc);
+  }
+
+  return nc;
+}
+
+/*
+Compute a canonical ordering of a triangulated plane graph
+Input: A triangulated plane graph g. The adjacency list of each vertex is in
+ccw order. The vertex 0 is v1, the first vertex of its adjacency list is v2
+and the last one is vn, so (v1, v2, vn) is the outer face.
+Output: An array co, where co[v] is the order of the vertex v (from 0 to n-1)
+
+The ordering is computed in reverse by shelling the graph (de Fraysseix, Pach
+and Pollack): starting with the contour v1, vn, v2, the vertex with order k is
+a contour vertex, different from v1 and v2, without incident chords. Once it
+is removed, its neighbors not yet removed are added to the contour. The
+contour is stored as a doubly linked list, from v1 to v2, and each contour
+vertex stores the number of chords incident to it.
+
+While there are few removable vertices the shelling is sequential. Otherwise
+it is done in rounds: the removable vertices claim themselves and their
+neighbors not yet removed, and the ones that win all their claims (the
+smallest priority wins) are removed in parallel. Two vertices removed in the
+same round are not adjacent and have no common neighbor left, so their
+removals touch disjoint parts of the contour and give the same result in any
+order. The choice between both modes and the selection only depend on the
+graph, so the ordering is the same for any number of workers.
+*/
+idx_t* canonical_ordering(Graph* g) {
+  idx_t n = g->n;
+  idx_t* co = malloc(n*sizeof(idx_t));
+
+  if(n < 3) {
+    for(idx_t i = 0; i < n; i++)
+      co[i] = i;
+    return co;
+  }
+
+  struct co_args a;
+  a.g = g;
+  a.co = co;
+  a.cprev = malloc(n*sizeof(idx_t));
+  a.cnext = malloc(n*sizeof(idx_t));
+  a.chords = malloc(n*sizeof(idx_t));
+  a.state = malloc(n*sizeof(char));
+  a.owner = malloc(n*sizeof(idx_t));
+  // A vertex is pushed when it enters the contour and each removal pushes at
+  // most two more vertices
+  a.cand = malloc(3*n*sizeof(idx_t));
+  a.next = malloc(3*n*sizeof(idx_t));
+  a.removed = malloc(n*sizeof(idx_t));
+  a.sel = malloc(n*sizeof(idx_t));
+  a.ret = malloc(n*sizeof(idx_t));
+  a.cnt = malloc(n*sizeof(idx_t));
+
+  parallel_for(0, n, co_init, &a);
+
+  idx_t v1 = 0;
+  idx_t v2 = g->E[g->V[v1].first].tgt;
+  idx_t vn = g->E[g->V[v1].last].tgt;
+  a.v1 = v1;
+  a.v2 = v2;
+
+  a.cnext[v1] = vn; a.cprev[vn] = v1;
+  a.cnext[vn] = v2; a.cprev[v2] = vn;
+  a.state[v1] = a.state[v2] = a.state[vn] = 1;
+  a.chords[v1] = a.chords[v2] = 1; // The edge (v1,v2)
+  co[v1] = 0;
+  co[v2] = 1;
+
+  idx_t nc = 1;
+  a.cand[0] = vn;
+  a.k = n-1;
+  while(a.k >= 2) {
+    if(nc == 0)
+      not_a_triangulation();
+
+    if(nc < CO_PARALLEL_MIN) {
+      nc = co_shell(&a, nc);
+      continue;
+    }
+
+    parallel_for(0, nc, co_claim_nbrs, &a);
+    parallel_for(0, nc, co_select, &a);
+    parallel_prefix_sum(a.sel, nc);
+    parallel_prefix_sum(a.ret, nc);
+    idx_t ns = a.sel[nc-1];
+    a.kept = a.ret[nc-1];
+    if(ns == 0)
+      not_a_triangulation();
+    parallel_for(0, nc, co_compact, &a);
+
+    parallel_for(0, ns, co_remove, &a);
+    parallel_prefix_sum(a.cnt, ns);
+    parallel_for(0, ns, co_count_chords, &a);
+    parallel_for(0, ns, co_push, &a);
+
+    idx_t* tmp = a.cand;
+    a.cand = a.next;
+    a.next = tmp;
+    nc = a.kept + a.cnt[ns-1];
+    a.k -= ns;
+  }
+
+  free(a.cprev);
+  free(a.cnext);
+  free(a.chords);
+  free(a.state);
+  free(a.owner);
+  free(a.cand);
+  free(a.next);
+  free(a.removed);
+  free(a.sel);
+  free(a.ret);
+  free(a.cnt);
+
+  return co;
+}
+
+// Data shared by the parallel loops of canonical_spanning_tree
+struct cst_args {
+  Graph* g;
+  Tree* t;
+  idx_t* ppos; // Position of the parent in g->E
+  idx_t* parent;
+  idx_t* cpos; // Position of a node in the list of its parent in t->E
+  idx_t* size;
+};
+
+// Parent of the vertex v
+static void cst_parent(long v, void* arg) {
+  struct cst_args* a = arg;
+  Graph* g = a->g;
+  Vertex u = g->V[v];
+  idx_t e = u.first;
+
+  if(v != 0) {
+    idx_t prev = u.last;
+    for(e = u.first; e <= u.last; e++) {
+      if(g->V[g->E[e].tgt].order < u.order &&
+	 g->V[g->E[prev].tgt].order > u.order)
+	break;
+      prev = e;
+    }
+
+    if(e > u.last) // vn
+      for(e = u.first; g->E[e].tgt != 0; e++);
+  }
+
+  a->ppos[v] = e;
+  a->parent[v] = (v == 0) ? 0 : g->E[e].tgt;
+}
+
+// Number of children of the vertex v
+static void cst_size(long v, void* arg) {
+  struct cst_args* a = arg;
+  Vertex u = a->g->V[v];
+  idx_t c = 0;
+  for(idx_t e = u.first; e <= u.last; e++) {
+    idx_t w = a->g->E[e].tgt;
+    c += (a->parent[w] == (idx_t)v && w != 0);
+  }
+  a->size[v] = c + (v != 0);
+}
+
+// Adjacency list of the vertex v, starting at the parent (or v2 for the root)
+static void cst_list(long v, void* arg) {
+  struct cst_args* a = arg;
+  Graph* g = a->g;
+  Tree* t = a->t;
+  Vertex u = g->V[v];
+  idx_t first = (v == 0) ? 0 : a->size[v-1];
+  idx_t m = first;
+
+  t->N[v].first = first;
+  t->N[v].last = a->size[v]-1;
+
+  if(v != 0) {
+    t->E[m].src = v;
+    t->E[m].tgt = a->parent[v];
+    m++;
+  }
+
+  idx_t e = a->ppos[v];
+  for(idx_t i = 0; i <= u.last-u.first; i++) {
+    idx_t w = g->E[e].tgt;
+    if(a->parent[w] == (idx_t)v && w != 0) {
+      t->E[m].src = v;
+      t->E[m].tgt = w;
+      t->E[m].p_tgt = a->size[w-1]; // The parent is the first node of the list
+      a->cpos[w] = m;
+      m++;
+    }
+    e = (e == u.last) ? u.first : e+1;
+  }
+}
+
+// Position of the complement of the edge from the vertex v to its parent
+static void cst_complement(long v, void* arg) {
+  struct cst_args* a = arg;
+  a->t->E[a->size[v-1]].p_tgt = a->cpos[v];
+}
+
+/*
+Compute the canonical spanning tree of a triangulated plane graph
+Input: A triangulated plane graph g, where g->V[v].order is the canonical
+ordering of the vertex v and the vertex 0 is v1
+Output: The canonical spanning tree, rooted at the vertex 0. The adjacency
+list of each node starts with its parent (except the root) followed by its
+children in ccw order. The adjacency list of the root starts with v2
+
+The parent of a vertex is its leftmost lower neighbor: the lower neighbors of
+a vertex are contiguous in ccw order, so the parent is the lower neighbor
+whose previous neighbor (in ccw order) is a higher vertex. vn has no higher
+neighbors, its parent is v1. All the steps are parallel loops over the
+vertices, and the position of the complement of each edge (p_tgt) is obtained
+while the children are written, so the total work is O(n+m).
+*/
+Tree* canonical_spanning_tree(Graph* g) {
+  idx_t n = g->n;
+  Tree* t = malloc(sizeof(Tree));
+  t->n = n;
+  t->N = malloc(n*sizeof(Node));
+  t->E = malloc(2*(n-1)*sizeof(Edge));
+
+  idx_t* ppos = malloc(n*sizeof(idx_t));
+  idx_t* parent = malloc(n*sizeof(idx_t));
+  idx_t* cpos = malloc(n*sizeof(idx_t));
+  idx_t* size = malloc(n*sizeof(idx_t));
+  struct cst_args args = {g, t, ppos, parent, cpos, size};
+
+  // Parents
+  parallel_for(0, n, cst_parent, &args);
+
+  // Number of children of each node
+  parallel_for(0, n, cst_size, &args);
+
+  parallel_prefix_sum(size, n);
+
+  // Adjacency lists
+  parallel_for(0, n, cst_list, &args);
+
+  parallel_for(1, n, cst_complement, &args);
+
+  free(ppos);
+  free(parent);
+  free(cpos);
+  free(size);
+
+  return t;
+}
@@ -31,7 +31,7 @@
 #include "defs.h"
 #include <math.h>
 
-Graph* createGraph(uint n, uint m) {
+Graph* createGraph(idx_t n, idx_t m) {
 
   Graph *g = malloc(sizeof(Graph));
   g->n = n;
@@ -48,47 +48,47 @@ void deleteGraph(Graph* g){
   free(g);
 }
 
-uint degree(Vertex v) {
+idx_t degree(Vertex v) {
   return v.last - v.first + 1;
 }
 
-Vertex vertex(Graph *g, uint i) {
+Vertex vertex(Graph *g, idx_t i) {
   return g->V[i];
 }
 
-Edge edge(Graph* g, uint e) {
+Edge edge(Graph* g, idx_t e) {
   return g->E[e];
 }
 
-uint edges(Graph* g) {
+idx_t edges(Graph* g) {
   return g->m;
 }
 
-uint vertices(Graph* g) {
+idx_t vertices(Graph* g) {
   return g->n;
 }
 
-uint firstE( Vertex v) {
+idx_t firstE( Vertex v) {
   return v.first;
 }
 
-uint nextE(Vertex v, uint i) {
+idx_t nextE(Vertex v, idx_t i) {
   return min(v.last,i+1);
 }
 
-uint prevE(Vertex v, uint i) {
+idx_t prevE(Vertex v, idx_t i) {
   return max(v.first,i-1);
 }
 
-uint lastE(Vertex v) {
+idx_t lastE(Vertex v) {
   return v.last;
 }
 
-uint pSource(Edge e) {
+idx_t pSource(Edge e) {
   return e.src;
 }
 
-uint pTarget(Edge e) {
+idx_t pTarget(Edge e) {
   return e.tgt;
 }
 
@@ -105,122 +105,273 @@ Vertex target(Graph *g, Edge e) {
 }
 
 
+struct prefix_sum_args {
+  idx_t* A;
+  idx_t size;
+  idx_t chk;
+};
+
+// Prefix sum of the block i
+static void prefix_sum_block(long i, void* arg) {
+  struct prefix_sum_args* a = arg;
+  idx_t  ll = i*a->chk, ul = ll + a->chk;
+  if(ul > a->size)
+    ul = a->size;
+
+  idx_t acc = 0;
+  for(idx_t j = ll; j < ul; j++) {
+    a->A[j] += acc;
+    acc = a->A[j];
+  }
+}
+
+// Add the sum of the previous blocks to the block i (but its last element)
+static void prefix_sum_add(long i, void* arg) {
+  struct prefix_sum_args* a = arg;
+  idx_t ll = i*a->chk, ul = ll + a->chk - 1;
+  if(ul >= a->size)
+    ul = a->size - 1;
+
+  idx_t acc = a->A[ll-1];
+  for(idx_t j = ll; j < ul; j++) {
+    a->A[j] += acc;
+  }
+}
+
 /*
 Compute in parallel the prefix sum of an array of uints
 Input: An array A of uints, the size the array and the number of available threads.
 Output: None. The prefix sums will be saved in the array A
 
-Note: This algorithm assumes that size >= threads
+Note: The array is split into blocks of ceil(size/threads) elements, so when
+size is small some threads get no block (e.g. 500 elements and 64 threads give
+56 blocks of 9 elements). Only the non-empty blocks are processed.
 */
-void parallel_prefix_sum(uint* A, uint size) {
-  uint chk = ceil((float)size/threads);
-  cilk_for(uint i = 0; i < threads; i++) {
-    uint  ll = i*chk, ul = ll + chk;
-    if(ul > size)
-      ul = size;
-
-    uint acc = 0;
-    for(uint j = ll; j < ul; j++) {
-      A[j] += acc;
-      acc = A[j];
-    }
-  }
-  
-  for(uint i = 1; i < threads-1; i++)
-    A[((i+1)*chk)-1] += A[i*chk-1];
-  
-  if(threads > 1)
-    A[size-1] += A[(threads-1)*chk-1];
+void parallel_prefix_sum(idx_t* A, idx_t size) {
+  if(size == 0)
+    return;
+
+  idx_t chk = ceil((double)size/threads);
+  idx_t blocks = (size + chk - 1)/chk;
+  struct prefix_sum_args args = {A, size, chk};
+  parallel_for(0, blocks, prefix_sum_block, &args);
   
-  cilk_for(uint i = 1; i < threads; i++) {
-    uint ll = i*chk, ul = ll + chk - 1;
-    if(ul >= size)
-      ul = size - 1;
-
-    uint acc = A[ll-1];
-    for(uint j = ll; j < ul; j++) {
-      A[j] += acc;
-    }
+  // Last element of each block. The last block may be shorter
+  for(idx_t i = 1; i < blocks; i++) {
+    idx_t last = (i+1)*chk < size ? (i+1)*chk : size;
+    A[last-1] += A[i*chk-1];
   }
   
+  parallel_for(1, blocks, prefix_sum_add, &args);
+  
 }
 
-void parallel_list_ranking(ENode* A, uint size) {  
-   struct sublist_node {
-     int head;
-     int next;
-     int scratch;
-     int value;
-   };
-
-   uint s = ceil(log2(size)*threads);
-   uint chk = size/s;
-
-   struct sublist_node* sublist = malloc(s*sizeof(struct sublist_node));
-
-   int curr2 = A[0].next;
-   int cnt = 1;
-   while(curr2 > 0) {
-      curr2 = A[curr2].next;
-      cnt++;
-      if(cnt > size)
-  	break;
-   }
- 
-   // Compute the splitters
-   cilk_for(uint i = 0; i < s; i++) {
-     uint x = i*chk;
-     sublist[i].head = x;
-     sublist[i].value = A[x].rank;
-     sublist[i].next = -1;
-     sublist[i].scratch = A[x].next;
-     A[x].next = -(i)-1;
-   }
-   
-   cilk_for(uint i = 0; i < s; i++) {
-     int curr = sublist[i].scratch;
-     uint tmp = 0, tmp2 = 0;
-    
-    while(curr > 0) {
-      tmp2 = A[curr].rank;
-      A[curr].rank = tmp;
-      tmp += tmp2;
-      
-      int aux = A[curr].next;
-      A[curr].next = -(i)-1;
-      curr = aux;
-   }
-    sublist[i].next = -(curr)-1;
-
-    // Special case
-    if(curr != 0)
-      sublist[-(curr)-1].value = tmp;
-   }
-   
-  int curr = 0;
-  int tmp = 0, tmp2 = 0;
+/*
+List ranking engine used by parallel_list_ranking and
+parallel_multi_list_ranking. The successor of the node i is next[i*ns] and
+its j-th weight is W[i*ws+j].
+
+1. The list is split into sublists by randomized splitters: the positions of
+   the array are divided into s buckets and each bucket contributes the head of
+   one sublist at a random position (the bucket 0 contributes the head of the
+   list). Random heads avoid pathological sublist lengths when the layout of
+   the list follows the layout of the array.
+2. The sublists are traversed in parallel, computing the local ranks of their
+   nodes and the total weight of each sublist. Each node stores the index of
+   its sublist in next.
+3. The global offset of each sublist is computed by pointer jumping over the
+   list of sublists (O(log s) parallel rounds).
+4. The offsets are added to the local ranks in parallel.
+*/
+#define NEXT(i) next[(size_t)(i)*ns]
+#define WEIGHT(i,j) W[(size_t)(i)*ws+(j)]
+
+// Pseudo-random number for the splitter of the bucket i
+static inline idx_t splitter_hash(idx_t i) {
+  unsigned long x = i + 0x9E3779B97F4A7C15UL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9UL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBUL;
+  return x ^ (x >> 31);
+}
+
+// Data shared by the parallel loops of list_ranking
+struct list_ranking_args {
+  sidx_t* next;
+  uint ns;
+  idx_t* W;
+  uint ws;
+  uint k;
+  idx_t size;
+  idx_t s; // Number of sublists
+  idx_t chk; // Bucket size (bucket size of the last step)
+  sidx_t* head;
+  sidx_t* succ; // Next sublist (-1 for the last one)
+  sidx_t* succ2;
+  idx_t* value; // Total weight of each sublist
+  idx_t* value2;
+  idx_t* scratch; // Successor of each head
+};
+
+// Splitter of the bucket i
+static void lr_splitter(long i, void* arg) {
+  struct list_ranking_args* a = arg;
+  sidx_t* next = a->next;
+  uint ns = a->ns;
+  idx_t ll = i*a->chk, len = ((idx_t)i == a->s-1) ? a->size - ll : a->chk;
+  idx_t x = (i == 0) ? 0 : ll + splitter_hash(i)%len;
+  a->head[i] = x;
+  a->scratch[i] = NEXT(x);
+  NEXT(x) = -(i)-1;
+}
+
+// Traverse the sublist i
+static void lr_traverse(long i, void* arg) {
+  struct list_ranking_args* a = arg;
+  sidx_t* next = a->next;
+  idx_t* W = a->W;
+  uint ns = a->ns, ws = a->ws, k = a->k;
+  idx_t tmp[k];
+  sidx_t curr = a->head[i];
+  sidx_t nxt = a->scratch[i];
+
+  for(uint j = 0; j < k; j++)
+    tmp[j] = 0;
 
   while(1) {
-    tmp2 = sublist[curr].value;
-    sublist[curr].value += tmp;
-    tmp += tmp2;
-    curr = sublist[curr].next;
-    if(curr < 0)
+    for(uint j = 0; j < k; j++) {
+      idx_t w = WEIGHT(curr,j);
+      WEIGHT(curr,j) = tmp[j];
+      tmp[j] += w;
+    }
+
+    if(nxt == 0) { // End of the list
+      a->succ[i] = -1;
       break;
-  }
-  
-  cilk_for(uint i = 0; i < s; i++) {
-    uint  ll = i*chk, ul = ll + chk;
-    if(i == s-1)
-      ul = size;
-    if(i == 0)
-      ll++;
-
-    for(uint j = ll; j < ul; j++) {
-      int idx = -(A[j].next)-1;
-      A[j].rank += sublist[idx].value;
     }
+    if(NEXT(nxt) < 0) { // Head of another sublist
+      a->succ[i] = -(NEXT(nxt))-1;
+      break;
+    }
+
+    curr = nxt;
+    nxt = NEXT(curr);
+    NEXT(curr) = -(i)-1;
   }
 
-  A[0].rank=0;
+  for(uint j = 0; j < k; j++)
+    a->value[i*k+j] = tmp[j];
+}
+
+// One round of pointer jumping for the sublist i
+static void lr_jump(long i, void* arg) {
+  struct list_ranking_args* a = arg;
+  uint k = a->k;
+  sidx_t nxt = a->succ[i];
+  for(uint j = 0; j < k; j++)
+    a->value2[i*k+j] = a->value[i*k+j] + ((nxt < 0) ? 0 : a->value[nxt*k+j]);
+  a->succ2[i] = (nxt < 0) ? -1 : a->succ[nxt];
+}
+
+// Offset of the sublist i
+static void lr_offset(long i, void* arg) {
+  struct list_ranking_args* a = arg;
+  uint k = a->k;
+  for(uint j = 0; j < k; j++)
+    a->value2[i*k+j] = a->value[j] - a->value[i*k+j];
+}
+
+// Add the offsets of their sublists to the nodes of the block h
+static void lr_add(long h, void* arg) {
+  struct list_ranking_args* a = arg;
+  sidx_t* next = a->next;
+  idx_t* W = a->W;
+  uint ns = a->ns, ws = a->ws, k = a->k;
+  idx_t ll = h*a->chk, ul = ll + a->chk;
+  if(ul > a->size)
+    ul = a->size;
+
+  for(idx_t x = ll; x < ul; x++) {
+    idx_t idx = -(NEXT(x))-1;
+    for(uint j = 0; j < k; j++)
+      WEIGHT(x,j) += a->value2[idx*k+j];
+  }
+}
+
+static void list_ranking(sidx_t* next, uint ns, idx_t* W, uint ws, uint k,
+			 idx_t size) {
+  if(size == 0)
+    return;
+
+  idx_t s = ceil(log2(size)*threads);
+  if(s > size)
+    s = size;
+  if(s == 0)
+    s = 1;
+
+  struct list_ranking_args a = {.next = next, .ns = ns, .W = W, .ws = ws,
+				.k = k, .size = size, .s = s, .chk = size/s};
+  a.head = malloc(s*sizeof(sidx_t));
+  a.succ = malloc(s*sizeof(sidx_t));
+  a.succ2 = malloc(s*sizeof(sidx_t));
+  a.value = malloc(s*k*sizeof(idx_t));
+  a.value2 = malloc(s*k*sizeof(idx_t));
+  a.scratch = malloc(s*sizeof(idx_t));
+
+  // Compute the splitters
+  parallel_for(0, s, lr_splitter, &a);
+
+  // Traverse the sublists
+  parallel_for(0, s, lr_traverse, &a);
+
+  // Pointer jumping: value[i] = total weight of the sublists from i to the end
+  uint rounds = ceil(log2(s)) + 1;
+  for(uint r = 0; r < rounds; r++) {
+    parallel_for(0, s, lr_jump, &a);
+
+    idx_t* tv = a.value; a.value = a.value2; a.value2 = tv;
+    sidx_t* ts = a.succ; a.succ = a.succ2; a.succ2 = ts;
+  }
+
+  // Offset of each sublist: total weight minus the weight from it to the end
+  parallel_for(0, s, lr_offset, &a);
+
+  a.chk = ceil((double)size/threads);
+  parallel_for(0, threads, lr_add, &a);
+
+  free(a.head);
+  free(a.succ);
+  free(a.succ2);
+  free(a.value);
+  free(a.value2);
+  free(a.scratch);
+}
+
+#undef NEXT
+#undef WEIGHT
+
+/*
+Compute in parallel the list ranking of an array of ENodes
+Input: An array A of ENodes and its size. The list starts at the position 0
+and finishes at the node whose successor is 0. A[i].rank is the weight of the
+node i.
+Output: None. A[i].rank is replaced by the sum of the weights of the nodes
+that precede the node i in the list. The next fields are overwritten.
+*/
+void parallel_list_ranking(ENode* A, idx_t size) {
+  list_ranking(&A[0].next, sizeof(ENode)/sizeof(sidx_t), &A[0].rank,
+	       sizeof(ENode)/sizeof(idx_t), 1, size);
+}
+
+/*
+Fused version of parallel_list_ranking. It ranks k weight vectors over the
+same successor array in a single traversal of the list.
+Input: The successor array next (the list starts at the position 0 and
+finishes at the node whose successor is 0), the array of weights W, where
+W[i*k+j] is the j-th weight of the node i, the number k of weights per node
+and the number of nodes.
+Output: None. W[i*k+j] is replaced by the sum of the j-th weights of the nodes
+that precede the node i in the list. The array next is overwritten.
+*/
+void parallel_multi_list_ranking(sidx_t* next, idx_t* W, uint k, idx_t size) {
+  list_ranking(next, 1, W, k, k, size);
 }
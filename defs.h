@@ -29,23 +29,14 @@
 #include "bit_array.h"
 #include <math.h>
 
-#ifdef NOPARALLEL
-#define cilk_for for
-#define cilk_spawn
-#define cilk_sync
-#define __cilkrts_get_nworkers() 1
-#else
-#include <cilk/cilk.h>
-#include <cilk/cilk_api.h>
-#include <cilk/common.h>
-#endif
+#include "parallel.h"
 
 #ifdef MALLOC_COUNT
 #include "malloc_count.h"
 #endif
 
 
-#define threads  __cilkrts_get_nworkers()
+#define threads  parallel_workers()
 
 #define min(a,b)	      \
   ({ __typeof__ (a) _a = (a); \
@@ -66,92 +57,106 @@ typedef struct _euler_node ENode;
 typedef unsigned int uint;
 typedef struct _subgraph_node Subgraph;
 
+/*
+ * Indices of vertices, edges and parentheses. They are 32-bit by default, so
+ * small graphs keep a compact layout. Compile with -DIDX64 (the BIT_ARRAY and
+ * the min-max trees follow the same flag) to build graphs whose succinct
+ * representation has more than 2^31 bits.
+ */
+#ifdef IDX64
+typedef uint64_t idx_t;
+typedef int64_t sidx_t; // Signed index
+#else
+typedef uint32_t idx_t;
+typedef int32_t sidx_t; // Signed index
+#endif
+
 // Used to represent graphs
 struct _vertex_t {
-  uint first; // Position of the first incident edge of a vertex in E
-  uint last; // Position of the last incident edge of a vertex in E
-  uint order; // Its order in the canonical ordering
+  idx_t first; // Position of the first incident edge of a vertex in E
+  idx_t last; // Position of the last incident edge of a vertex in E
+  idx_t order; // Its order in the canonical ordering
 };
 
 // Used to represent graphs and trees
 struct _edge_t {
-  uint src; // Index of the source vertex of the edge
-  uint tgt; // Index of the target vertex of the edge
-  // uint p_src; // Position of the edge in the adjacency list of src
+  idx_t src; // Index of the source vertex of the edge
+  idx_t tgt; // Index of the target vertex of the edge
+  // idx_t p_src; // Position of the edge in the adjacency list of src
   // Note that p_src is the same index of the edge in E
-  uint p_tgt; // Position of the edge in the adjacency list of tgt
+  idx_t p_tgt; // Position of the edge in the adjacency list of tgt
 };
 
 // Used to represent trees
 struct _node_t {
-  uint first; // Position of the first incident edge of a node in E
-  uint last; // Position of the last incident edge of a node in E
-  //  uint size; // Number of nodes in the subtree rooted at this node
+  idx_t first; // Position of the first incident edge of a node in E
+  idx_t last; // Position of the last incident edge of a node in E
+  //  idx_t size; // Number of nodes in the subtree rooted at this node
 };
 
 struct _graph_t {
   Vertex* V; // Array of vertices of the graph
   Edge* E; // Array of edges of the graph. It is the concatenation of the adjacency lists of all vertices
-  uint n; // Number of vertices in the graph
-  uint m; // Number of non-repeated edges in the graph
+  idx_t n; // Number of vertices in the graph
+  idx_t m; // Number of non-repeated edges in the graph
 };
 
 struct _tree_t {
   Node* N; // Array of nodes of the tree
   Edge* E; // Array of edges of the tree. It is the concatenation of the adjacency lists of all nodes
-  uint n; // Number of nodes in the tree
+  idx_t n; // Number of nodes in the tree
   // The number of edges is n-1
 };
 
 // struct for the Euler tour code
 struct _euler_node {
-  int next; // stores the index of the next value in the array. Since
-	    // the parallel_list_ranking algorithm uses this fields to
-	    // store some negative values, it must be int instead of uint.
+  sidx_t next; // stores the index of the next value in the array. Since
+	       // the parallel_list_ranking algorithm uses this fields to
+	       // store some negative values, it must be signed.
   char value;
-  uint rank;
+  idx_t rank;
 };
 
 // Create a new graph with n vertices and m edges
-Graph* createGraph(uint, uint);
+Graph* createGraph(idx_t, idx_t);
 
 // Free the memory used by a graph
 void deleteGraph(Graph*);
 
 // Return the degree of a vertex
-uint degree(Vertex);
+idx_t degree(Vertex);
 
 // Given a position, it returns the vertex at that position
-Vertex vertex(Graph*, uint);
+Vertex vertex(Graph*, idx_t);
 
 // Given a position, it returns the edge at that position
-Edge edge(Graph*, uint);
+Edge edge(Graph*, idx_t);
 
 // Return the number of vertices in the graph
-uint vertices(Graph* g);
+idx_t vertices(Graph* g);
 
 // Return the number of edges in the graph
-uint edges(Graph* g);
+idx_t edges(Graph* g);
 
 // Given a vertex, it returns the position of the first edge of that vertex
-uint firstE(Vertex);
+idx_t firstE(Vertex);
 
 // Given a vertex and the position of a edge, it returns the position
 // of the next edge of that vertex in ccw order
-uint nextE(Vertex, uint i);
+idx_t nextE(Vertex, idx_t i);
 
 // Given a vertex and the position of a edge, it returns the position
 // of the previous edge of that vertex in ccw order
-uint prevE(Vertex, uint i);
+idx_t prevE(Vertex, idx_t i);
 
 // Given a vertex, it returns the position of the last edge of that vertex
-uint lastE(Vertex);
+idx_t lastE(Vertex);
 
 // Given an edge, it returns the position of the source vertex of that edge
-uint pSource(Edge);
+idx_t pSource(Edge);
 
 // Given an edge, it returns the position of the target vertex of that edge
-uint pTarget(Edge);
+idx_t pTarget(Edge);
 
 // Given an edge, it returns the complement edge of that edge
 Edge complement(Graph*, Edge);
@@ -164,6 +169,18 @@ Vertex target(Graph*, Edge);
 
 /*============= LIST RANKING ==================*/
 
-void parallel_prefix_sum(uint*, uint);
-void parallel_list_ranking(ENode*, uint);
+// Inclusive prefix sum of an array of any size (see defs.c)
+void parallel_prefix_sum(idx_t*, idx_t);
+void parallel_list_ranking(ENode*, idx_t);
+void parallel_multi_list_ranking(sidx_t*, idx_t*, uint, idx_t);
+
+/*============= CANONICAL ORDERING ==================*/
+
+// Given a triangulated plane graph, it returns the canonical ordering of its
+// vertices, taking the vertex 0 as v1 (see canonical_ordering.c)
+idx_t* canonical_ordering(Graph*);
+
+// Given a triangulated plane graph and its canonical ordering (stored in the
+// vertices), it returns its canonical spanning tree
+Tree* canonical_spanning_tree(Graph*);
 
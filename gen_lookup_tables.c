@@ -0,0 +1,84 @@
+/******************************************************************************
+ * gen_lookup_tables.c
+ *
+ * Parallel construction of succinct triangulated plane graphs
+ * For more information: http://thesis.josefuentes.cl
+ *
+ ******************************************************************************
+ * Copyright (C) 2016 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * Build-time generator of the lookup tables. It writes to stdout a C file that
+ * defines the constant 'lookup_tables' (see lookup_tables.h), so the programs
+ * do not compute the tables at run time. It must be compiled with the same
+ * LOOKUP16 flag as the programs:
+ *
+ *   gcc -DNOPARALLEL -o gen_lookup_tables gen_lookup_tables.c lookup_tables.c
+ *   ./gen_lookup_tables > lookup_tables_data.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lookup_tables.h"
+
+#define LEN(a) (sizeof(a)/sizeof((a)[0]))
+
+// Print the array a of integers as the initializer of the field name
+#define PRINT_ARRAY(name, a, fmt) do {				\
+    printf("  .%s = {", name);					\
+    for(size_t i = 0; i < LEN(a); i++)				\
+      printf("%s" fmt, (i % 16) ? ", " : (i ? ",\n    " : "\n    "), (a)[i]); \
+    printf("\n  },\n");						\
+  } while(0)
+
+int main() {
+  lookup_table* T = create_lookup_tables();
+
+  printf("/* Generated by gen_lookup_tables. Do not edit */\n\n");
+  printf("#include \"lookup_tables.h\"\n\n");
+  printf("const lookup_table lookup_tables = {\n");
+
+  PRINT_ARRAY("near_fwd_pos", T->near_fwd_pos, "%u");
+  PRINT_ARRAY("near_bwd_pos", T->near_bwd_pos, "%u");
+  PRINT_ARRAY("word_sum", T->word_sum, "%d");
+  PRINT_ARRAY("min", T->min, "%d");
+  PRINT_ARRAY("min_pos_max", T->min_pos_max, "%d");
+  PRINT_ARRAY("min_match_pos_packed", T->min_match_pos_packed, "0x%08xU");
+  PRINT_ARRAY("max_match_pos_packed", T->max_match_pos_packed, "0x%08xU");
+  PRINT_ARRAY("min_open_excess_info", T->min_open_excess_info, "0x%04x");
+
+#ifdef LOOKUP16
+  printf("  .word16 = {");
+  for(size_t w = 0; w < LEN(T->word16); w++) {
+    word16_info x = T->word16[w];
+    printf("%s{%d, %d, %d, %u}", (w % 8) ? ", " : (w ? ",\n    " : "\n    "),
+	   x.sum, x.min, x.max, x.min_pos_max);
+  }
+  printf("\n  },\n");
+#endif
+
+  printf("};\n");
+
+  free(T);
+  return 0;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * kary_trees.h
+ *
+ * Parallel construction of succinct triangulated plane graphs
+ * For more information: http://thesis.josefuentes.cl
+ *
+ ******************************************************************************
+ * Copyright (C) 2016 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef KARY_TREES_H
+#define KARY_TREES_H
+
+/* Auxiliar functions for complete k-ary trees stored in heap order (the
+ * children of the node v are k*v+1, ..., k*v+k). The arity is RMMT_K */
+#include "succinct_tree.h"
+
+static inline int is_root(long v) {
+  return v==0;
+}
+
+static inline long parent(long v) {
+  if(is_root(v))
+    return 0;
+  return (v-1)/RMMT_K;
+}
+
+static inline long first_child(long v) {
+  return RMMT_K*v+1;
+}
+
+static inline long last_child(long v) {
+  return RMMT_K*v+RMMT_K;
+}
+
+// First (last) sibling of v, v itself included
+static inline long first_sibling(long v) {
+  return first_child(parent(v));
+}
+
+static inline long last_sibling(long v) {
+  return last_child(parent(v));
+}
+
+static inline int is_leaf(long v, rmMt* st) {
+  return (v >= (long)st->internal_nodes);
+}
+
+#endif // KARY_TREES_H
@@ -8,20 +8,34 @@
 
 #include <stdint.h>
 
+/*
+ * With -DLOOKUP16 the tables also summarize every 16-bit word (256 KB), so the
+ * scans advance 16 parentheses per step where the 8-bit tables are not needed
+ */
+#ifdef LOOKUP16
+// Given a 16-bit word w interpreted as parentheses sequence
+typedef struct {
+  int8_t sum; // Excess value of w
+  int8_t min; // Minimal excess value in w
+  int8_t max; // Maximal excess value in w
+  uint8_t min_pos_max; // Maximal position p where min is reached
+} word16_info;
+#endif
+
 struct _lookup_table {
   // Given an excess value x in [-8,8] and a 8-bit
   // word w interpreted as parentheses sequence.
   // near_fwd_pos[(x+8)<<8 | w] contains the minimal position
   // p in [0..7] where the excess value x is reached, or 8
   // if x is not reached in w.
-  uint8_t near_fwd_pos[(8-(-8))*256];
+  uint8_t near_fwd_pos[(8-(-8)+1)*256];
   
   // Given an excess value of x in [-8,8] and a 8-bit
   // word w interpreted as parentheses sequence.
   // near_bwd_pos[(x+8)<<8 | w] contains the maximal position
   // p in [0..7] where the excess value x is reached, or 8
   // if x is not reached in w.
-  uint8_t near_bwd_pos[(8-(-8))*256];
+  uint8_t near_bwd_pos[(8-(-8)+1)*256];
   
   // Given a 8-bit word w. word_sum[w] contains the
   // excess value of w.
@@ -58,11 +72,18 @@ struct _lookup_table {
   // if w != 0, and 17 for w=0.
   uint16_t min_open_excess_info[256];
   
-  
+#ifdef LOOKUP16
+  // Summaries of the 16-bit words, one cache access per word
+  word16_info word16[1 << 16];
+#endif
 };
 
 typedef struct _lookup_table lookup_table;
 
+// Tables generated at build time by gen_lookup_tables (lookup_tables_data.c)
+extern const lookup_table lookup_tables;
+
+// Compute the tables. It is only used by gen_lookup_tables
 lookup_table * create_lookup_tables();
 
 #endif // LOOKUP_TABLES_H
@@ -28,33 +28,88 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
 #include "parallel_succinct_graph.h"
 #include "succinct_tree.h"
 
+#ifndef MALLOC_COUNT
+/*
+ * Average latency (in nanoseconds) of the navigation operations over q random
+ * vertices (pairs of vertices for sg_adjacent). It is reported on stderr
+ */
+static void query_latencies(succ_graph* sg, unsigned long q) {
+  struct timespec stime, etime;
+  idx_t* N = (idx_t*)malloc(sg->n*sizeof(idx_t));
+  idx_t* V = (idx_t*)malloc(2*q*sizeof(idx_t));
+  unsigned long checksum = 0;
+
+  srand(0);
+  for(unsigned long i = 0; i < 2*q; i++)
+    V[i] = rand() % sg->n;
+
+  for(int op = 0; op < 3; op++) {
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stime);
+    for(unsigned long i = 0; i < q; i++) {
+      if(op == 0)
+	checksum += sg_degree(sg, V[i]);
+      else if(op == 1)
+	checksum += sg_neighbors(sg, V[i], N);
+      else
+	checksum += sg_adjacent(sg, V[i], V[q+i]);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &etime);
+
+    double ns = ((etime.tv_sec - stime.tv_sec)*1000000000.0 +
+		 (etime.tv_nsec - stime.tv_nsec)) / q;
+    fprintf(stderr, "%s: %.1lf ns/query\n",
+	    op == 0 ? "sg_degree" : (op == 1 ? "sg_neighbors" : "sg_adjacent"),
+	    ns);
+  }
+  fprintf(stderr, "Checksum: %lu\n", checksum);
+
+  free(N);
+  free(V);
+}
+#endif
+
 int main(int argc, char** argv) {
 
+#ifndef MALLOC_COUNT
   struct timespec stime, etime;
   double time;
+#endif
 
-  if(argc < 3) {
-    fprintf(stderr, "Usage: %s <input graph> <input spanning tree> <input\
-    canonical ordering>\n", argv[0]);
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s <input graph> [<input spanning tree> [<input\
+ canonical ordering>]]\n", argv[0]);
+    fprintf(stderr, "If the canonical ordering is omitted, it is computed from\
+ the graph. If the spanning tree is omitted or is \"-\", it is derived from\
+ the graph and the canonical ordering\n");
     exit(EXIT_FAILURE);
   }
 
   Graph* g = read_graph_from_file(argv[1]);
-  Tree* t = read_tree_from_file(argv[2]);
 
   // Adding the canonical ordering the graph g
-  uint* co = read_canonical_ordering_from_file(argv[3], g->n);
-  for(uint i = 0; i < g->n; i++) {
+  idx_t* co;
+  if(argc > 3)
+    co = read_canonical_ordering_from_file(argv[3], g->n);
+  else
+    co = canonical_ordering(g);
+  for(idx_t i = 0; i < g->n; i++) {
     g->V[i].order = co[i];
   }
   free(co);
 
+  Tree* t;
+  if(argc > 2 && strcmp(argv[2], "-") != 0)
+    t = read_tree_from_file(argv[2]);
+  else
+    t = canonical_spanning_tree(g);
+
 
 #ifdef MALLOC_COUNT
   size_t s_total_memory = malloc_count_total();
@@ -72,8 +127,10 @@ int main(int argc, char** argv) {
 #ifdef MALLOC_COUNT
   size_t e_total_memory = malloc_count_total();
   size_t e_current_memory = malloc_count_current();
-  printf("%s,%ld,%zu,%zu,%zu,%zu,%zu\n", argv[1], t->n, s_total_memory,
-  e_total_memory, malloc_count_peak(), s_current_memory, e_current_memory);
+  printf("%s,%lu,%zu,%zu,%zu,%zu,%zu\n", argv[1], (unsigned long)t->n,
+  s_total_memory, e_total_memory, malloc_count_peak(), s_current_memory,
+  e_current_memory);
+  (void)sg; // Only its working space is measured
   
 #else
   if (clock_gettime(CLOCK_THREAD_CPUTIME_ID , &etime)) {
@@ -82,7 +139,12 @@ int main(int argc, char** argv) {
   }
   
   time = (etime.tv_sec - stime.tv_sec) + (etime.tv_nsec - stime.tv_nsec) / 1000000000.0;
-  printf("%d,%s,%u,%lf\n", threads, argv[1], g->n, time);
+  printf("%d,%s,%lu,%lf\n", threads, argv[1], (unsigned long)g->n, time);
+
+  // SG_QUERIES=<q> measures the latency of the navigation operations
+  char* queries = getenv("SG_QUERIES");
+  if(queries != NULL && atol(queries) > 0)
+    query_latencies(sg, atol(queries));
 #endif
 
   return EXIT_SUCCESS;
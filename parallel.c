@@ -0,0 +1,309 @@
+/******************************************************************************
+ * parallel.c
+ *
+ * Parallel construction of succinct triangulated plane graphs
+ * For more information: http://thesis.josefuentes.cl
+ *
+ ******************************************************************************
+ * Copyright (C) 2016 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include "parallel.h"
+
+#ifdef WSPOOL
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * Work-stealing thread pool. The iterations of a parallel loop are split in
+ * one contiguous range per worker. A worker takes blocks of iterations from
+ * the front of its own range and, when it runs out of work, it steals the back
+ * half of the range of a victim worker.
+ *
+ * The owner of a range takes a block without locking (as in the THE protocol
+ * of Cilk): it publishes the new begin and then reads end, while a thief
+ * publishes the new end and then reads begin. If they overlap, the owner
+ * retries under the lock of the range and the thief gives up. Only the owner
+ * writes begin, and end is written by the owner or by a thief holding the lock.
+ */
+
+struct ws_range {
+  pthread_mutex_t lock;
+  long begin;
+  long end;
+  char pad[64]; // Avoid false sharing between the ranges of two workers
+};
+
+#define ws_load(x) __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define ws_store(x, v) __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+
+struct ws_pool {
+  unsigned int nworkers;
+  pthread_t* tids;
+  struct ws_range* ranges;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start; // Signaled when a new loop is available
+  pthread_cond_t done; // Signaled when the last worker finishes a loop
+  unsigned long generation; // Number of loops issued so far
+  unsigned int running; // Number of workers still working on the loop
+  int shutdown;
+
+  parallel_body body;
+  void* arg;
+  long block; // Iterations taken at once from the front of a range
+};
+
+static struct ws_pool* pool = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+// Serializes the loops issued by different threads, since the pool runs one
+// loop at a time
+static pthread_mutex_t issue_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int in_pool = 0; // The current thread is executing a loop
+
+// Take the next block [*lo,*hi) of the range r, owned by the caller. Returns 0
+// if the range is empty
+static int ws_pop(struct ws_range* r, long* lo, long* hi) {
+  long begin = r->begin;
+  long next = begin + pool->block;
+
+  ws_store(r->begin, next);
+  long end = ws_load(r->end);
+  if(next <= end) {
+    *lo = begin;
+    *hi = next;
+    return 1;
+  }
+
+  // The block overlaps the end of the range, which is stable under the lock
+  pthread_mutex_lock(&r->lock);
+  end = r->end;
+  if(next > end)
+    next = end;
+  if(begin >= end)
+    next = begin = end;
+  ws_store(r->begin, next);
+  pthread_mutex_unlock(&r->lock);
+
+  *lo = begin;
+  *hi = next;
+  return begin < next;
+}
+
+// Move the back half of the range of a victim to the range of worker id.
+// Returns 0 if there is nothing left to steal
+static int ws_steal(unsigned int id) {
+  struct ws_range* own = &pool->ranges[id];
+  unsigned int seed = id*2654435761U + 1;
+
+  for(unsigned int attempt = 0; attempt < 2*pool->nworkers; attempt++) {
+    seed = seed*1103515245U + 12345U;
+    unsigned int victim = (attempt < pool->nworkers) ?
+      (seed >> 16) % pool->nworkers : attempt - pool->nworkers;
+    if(victim == id)
+      continue;
+
+    struct ws_range* r = &pool->ranges[victim];
+    long begin = 0, end = 0;
+
+    pthread_mutex_lock(&r->lock);
+    long e = r->end, b = ws_load(r->begin);
+    if(b < e) {
+      begin = e - (e - b + 1)/2;
+      ws_store(r->end, begin);
+      // The owner took iterations after begin meanwhile
+      if(ws_load(r->begin) > begin) {
+	ws_store(r->end, e);
+	begin = e;
+      }
+      end = e;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if(begin < end) {
+      pthread_mutex_lock(&own->lock);
+      ws_store(own->begin, begin);
+      ws_store(own->end, end);
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static void ws_work(unsigned int id) {
+  long lo, hi;
+  in_pool = 1;
+  do {
+    while(ws_pop(&pool->ranges[id], &lo, &hi))
+      for(long i = lo; i < hi; i++)
+	pool->body(i, pool->arg);
+  } while(ws_steal(id));
+  in_pool = 0;
+}
+
+static void* ws_worker(void* arg) {
+  unsigned int id = (unsigned int)(long)arg;
+  unsigned long seen = 0;
+
+  while(1) {
+    pthread_mutex_lock(&pool->lock);
+    while(pool->generation == seen && !pool->shutdown)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if(pool->shutdown) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    ws_work(id);
+
+    pthread_mutex_lock(&pool->lock);
+    if(--pool->running == 0)
+      pthread_cond_signal(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+// Create the pool if it does not exist. It returns the number of workers
+static unsigned int ws_init() {
+  pthread_mutex_lock(&pool_lock);
+  if(pool != NULL) {
+    unsigned int nworkers = pool->nworkers;
+    pthread_mutex_unlock(&pool_lock);
+    return nworkers;
+  }
+
+  struct ws_pool* p = (struct ws_pool*)calloc(1, sizeof(struct ws_pool));
+  char* env = getenv("SG_NWORKERS");
+  long nworkers = (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+  p->nworkers = (nworkers > 0) ? nworkers : 1;
+  p->tids = (pthread_t*)malloc(p->nworkers*sizeof(pthread_t));
+  p->ranges = (struct ws_range*)calloc(p->nworkers, sizeof(struct ws_range));
+  for(unsigned int w = 0; w < p->nworkers; w++)
+    pthread_mutex_init(&p->ranges[w].lock, NULL);
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->start, NULL);
+  pthread_cond_init(&p->done, NULL);
+  pool = p;
+
+  // Worker 0 is the thread that issues the loops
+  for(unsigned int w = 1; w < p->nworkers; w++) {
+    if(pthread_create(&p->tids[w], NULL, ws_worker, (void*)(long)w)) {
+      fprintf(stderr, "Error: Unable to create the worker %u of the pool\n", w);
+      exit(EXIT_FAILURE);
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
+  return p->nworkers;
+}
+
+unsigned int ws_num_workers() {
+  return ws_init();
+}
+
+void ws_parallel_for(long lo, long hi, parallel_body body, void* arg) {
+  if(hi <= lo)
+    return;
+
+  // Nested loops and single-worker pools run on the calling thread
+  if(in_pool) {
+    for(long i = lo; i < hi; i++)
+      body(i, arg);
+    return;
+  }
+
+  pthread_mutex_lock(&issue_lock);
+  if(ws_init() == 1) {
+    pthread_mutex_unlock(&issue_lock);
+    for(long i = lo; i < hi; i++)
+      body(i, arg);
+    return;
+  }
+
+  long n = hi - lo;
+  long chk = n/pool->nworkers, rem = n%pool->nworkers;
+  long begin = lo;
+  for(unsigned int w = 0; w < pool->nworkers; w++) {
+    long len = chk + (w < rem);
+    pool->ranges[w].begin = begin;
+    pool->ranges[w].end = begin + len;
+    begin += len;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->body = body;
+  pool->arg = arg;
+  // About 8 blocks per worker, so the owners rarely meet the thieves
+  pool->block = chk/8 + 1;
+  pool->running = pool->nworkers - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  ws_work(0);
+
+  pthread_mutex_lock(&pool->lock);
+  while(pool->running > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_unlock(&issue_lock);
+}
+
+void ws_shutdown() {
+  pthread_mutex_lock(&issue_lock);
+  pthread_mutex_lock(&pool_lock);
+  if(pool == NULL) {
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_unlock(&issue_lock);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(unsigned int w = 1; w < pool->nworkers; w++)
+    pthread_join(pool->tids[w], NULL);
+
+  for(unsigned int w = 0; w < pool->nworkers; w++)
+    pthread_mutex_destroy(&pool->ranges[w].lock);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->ranges);
+  free(pool->tids);
+  free(pool);
+  pool = NULL;
+  pthread_mutex_unlock(&pool_lock);
+  pthread_mutex_unlock(&issue_lock);
+}
+
+#endif // WSPOOL
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * parallel.h
+ *
+ * Parallel construction of succinct triangulated plane graphs
+ * For more information: http://thesis.josefuentes.cl
+ *
+ ******************************************************************************
+ * Copyright (C) 2016 José Fuentes Sepúlveda <jfuentess@udec.cl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/*
+ * Parallel runtime layer. The backend is selected at compile time:
+ *
+ * -DNOPARALLEL : Sequential execution
+ * -DCILKPLUS   : Cilk Plus (legacy, requires -fcilkplus -lcilkrts)
+ * -DWSPOOL     : Built-in work-stealing thread pool (requires -pthread). The
+ *                number of workers is taken from the environment variable
+ *                SG_NWORKERS, or the number of online processors otherwise
+ * (default)    : OpenMP (requires -fopenmp). The number of workers is
+ *                controlled by OMP_NUM_THREADS
+ *
+ * A parallel loop over the range [lo,hi) calls body(i, arg) for each i. The
+ * body is an ordinary function and arg points to the data it shares with the
+ * caller, usually a struct:
+ *
+ *   struct fill_args { idx_t* A; idx_t x; };
+ *
+ *   static void fill_body(long i, void* arg) {
+ *     struct fill_args* a = arg;
+ *     a->A[i] = a->x;
+ *   }
+ *   ...
+ *   struct fill_args a = {A, x};
+ *   parallel_for(0, n, fill_body, &a);
+ *
+ * Iterations must be independent. parallel_for is inlined, so with the
+ * sequential and OpenMP backends the body is usually inlined as well.
+ */
+
+// Body of a parallel loop
+typedef void (*parallel_body)(long i, void* arg);
+
+#if defined(NOPARALLEL)
+
+#define parallel_workers() 1
+
+static inline void parallel_for(long lo, long hi, parallel_body body,
+				void* arg) {
+  for(long i = lo; i < hi; i++)
+    body(i, arg);
+}
+
+#elif defined(CILKPLUS)
+
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <cilk/common.h>
+
+#define parallel_workers() __cilkrts_get_nworkers()
+
+static inline void parallel_for(long lo, long hi, parallel_body body,
+				void* arg) {
+  cilk_for(long i = lo; i < hi; i++)
+    body(i, arg);
+}
+
+#elif defined(WSPOOL)
+
+#define parallel_workers() ((int)ws_num_workers())
+
+// Number of workers of the pool (the calling thread included)
+unsigned int ws_num_workers();
+
+// Execute body(i, arg) for each i in [lo,hi) using the workers of the pool.
+// Each worker owns a range of iterations and, once it is empty, steals half of
+// the remaining iterations of another worker. Nested calls run sequentially,
+// and calls from different threads run one after the other.
+void ws_parallel_for(long lo, long hi, parallel_body body, void* arg);
+
+// Stop the workers of the pool. It is created again on demand.
+void ws_shutdown();
+
+static inline void parallel_for(long lo, long hi, parallel_body body,
+				void* arg) {
+  ws_parallel_for(lo, hi, body, arg);
+}
+
+#else // OpenMP
+
+#include <omp.h>
+
+#define parallel_workers() omp_get_max_threads()
+
+// The iterations are handed out in blocks, about 8 per thread, so the threads
+// that finish first take the pending blocks of the others
+static inline void parallel_for(long lo, long hi, parallel_body body,
+				void* arg) {
+  long block = (hi - lo)/(8*omp_get_max_threads()) + 1;
+#pragma omp parallel for schedule(dynamic, block)
+  for(long i = lo; i < hi; i++)
+    body(i, arg);
+}
+
+#endif
+
+#endif // PARALLEL_H
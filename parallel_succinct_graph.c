@@ -33,7 +33,71 @@
 
 #include "parallel_succinct_graph.h"
 
-succ_graph* init_succ_graph(Graph* g, Tree* t) {
+/*
+ * Sequential writer of a range of bits of a BIT_ARRAY. The words of the range
+ * are assembled in a register and stored with plain writes, except the first
+ * one, which may be shared with the range of another thread. It is returned
+ * by bit_writer_close() to be merged later.
+ */
+#define WORD_BITS (8*sizeof(word_t))
+
+struct bit_writer {
+  word_t* words;
+  word_addr_t first; // First word of the range
+  word_addr_t curr; // Word being assembled
+  word_t acc; // Bits of the word being assembled
+  word_t head; // Bits of the first word
+};
+
+static inline void bit_writer_init(struct bit_writer* w, BIT_ARRAY* B,
+				   bit_index_t first_bit) {
+  w->words = B->words;
+  w->first = w->curr = first_bit/WORD_BITS;
+  w->acc = w->head = 0;
+}
+
+static inline void bit_writer_flush(struct bit_writer* w) {
+  if(w->curr == w->first)
+    w->head |= w->acc;
+  else if(w->acc)
+    w->words[w->curr] = w->acc;
+  w->acc = 0;
+}
+
+// Set the bit b. Bits must be set in increasing order of words
+static inline void bit_writer_set(struct bit_writer* w, bit_index_t b) {
+  if(b/WORD_BITS != w->curr) {
+    bit_writer_flush(w);
+    w->curr = b/WORD_BITS;
+  }
+  w->acc |= (word_t)1 << (b%WORD_BITS);
+}
+
+// Set the bits in the range [lo,hi)
+static inline void bit_writer_fill(struct bit_writer* w, bit_index_t lo,
+				   bit_index_t hi) {
+  while(lo < hi) {
+    if(lo/WORD_BITS != w->curr) {
+      bit_writer_flush(w);
+      w->curr = lo/WORD_BITS;
+    }
+    bit_index_t end = (w->curr+1)*WORD_BITS;
+    if(end > hi)
+      end = hi;
+    word_t mask = ~(word_t)0 >> (WORD_BITS - (end-lo));
+    w->acc |= mask << (lo%WORD_BITS);
+    lo = end;
+  }
+}
+
+static inline void bit_writer_close(struct bit_writer* w, word_addr_t* first,
+				    word_t* head) {
+  bit_writer_flush(w);
+  *first = w->first;
+  *head = w->head;
+}
+
+succ_graph* init_succ_graph(Graph* g) {
   succ_graph* sg = (succ_graph*)malloc(sizeof(succ_graph));
   sg->n = g->n;
   sg->m = g->m;
@@ -56,170 +120,554 @@ void print_succ_graph(succ_graph* sg) {
   fprintf(stderr, "Length of S3: %lu\n", sg->S3->n);
 }
 
-succ_graph* parallel_succinct_graph(Graph* g, Tree* t) {
-  /* Extra operations to increase artificially the workload of the
-  algorithm. This is only for testing. */
-  uint extraOps = 0;
+// Data shared by the parallel loops of parallel_succinct_graph
+struct psg_args {
+  Graph* g;
+  Tree* t;
+  idx_t* lower_numb;
+  idx_t* higher_numb;
+  sidx_t* next;
+  idx_t* W;
+  idx_t chk;
+  idx_t root_last;
+  idx_t* tour;
+  idx_t tour_size;
+  BIT_ARRAY* S1;
+  BIT_ARRAY* S2;
+  BIT_ARRAY* S3;
+  word_t* heads;
+  word_addr_t* firsts;
+};
 
-  // Section 0
-  succ_graph* sg = init_succ_graph(g, t);
+// Count the edges of each node with lower and higher canonical order
+static void count_edges(long h, void* arg) {
+  struct psg_args* a = arg;
+  Graph* g = a->g;
+  idx_t* lower_numb = a->lower_numb;
+  idx_t* higher_numb = a->higher_numb;
+  idx_t chk = a->chk;
 
-  uint num_parentheses = 2*t->n;
-  uint num_brackets = 2*(g->m - t->n + 1);
-  uint num_total = num_parentheses + num_brackets;
+  idx_t ll = h*chk;
+  idx_t ul = ll+chk;
+  if(h == 0)
+    ll = 1;
+  if(h == threads-1)
+    ul = 2*g->m;
 
-  BIT_ARRAY* S1 = bit_array_create(num_total);
-  BIT_ARRAY* S2 = bit_array_create(num_parentheses);
-  BIT_ARRAY* S3 = bit_array_create(num_brackets);
-
-  ushort* lower_numb = calloc(t->n,sizeof(ushort));
-  ushort* higher_numb = calloc(t->n,sizeof(ushort));
+  for(idx_t i = ll; i < ul; i++) {
+    Edge e = g->E[i];
+	
+    if(g->V[e.src].order > g->V[e.tgt].order)
+	__sync_add_and_fetch(&lower_numb[e.src], (idx_t)1);
+    else
+	__sync_add_and_fetch(&higher_numb[e.src], (idx_t)1);
 
-  ENode* ET = malloc((num_parentheses-2)*sizeof(ENode)); // S1
-  ENode* ET2 = malloc((num_parentheses-2)*sizeof(ENode)); // S2
+    // NOTE: Used to increase the workload
+    /* for(uint ii = 0; ii < extraOps; ii++) { */
+    /*   __atomic_compare_exchange_n(&next[i], &next[i], NULL, 0, */
+    /* 			      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
+    /* } */
+  }
+}
 
-  uint chk = 2*g->m/threads;
+// Discount the tree edges from the counters of each node
+static void adjust_counts(long h, void* arg) {
+  struct psg_args* a = arg;
+  Tree* t = a->t;
+  idx_t* lower_numb = a->lower_numb;
+  idx_t* higher_numb = a->higher_numb;
+  idx_t chk = a->chk;
 
-  cilk_for(uint h = 0; h < threads; h++) {
-    uint ll = h*chk;
-    uint ul = ll+chk;
-    if(h == 0)
-      ll = 1;
-    if(h == threads-1)
-      ul = 2*g->m;
+  idx_t ll = h*chk;
+  idx_t ul = ll+chk;
+  if(h == 0)
+    ll = 1;
+  if(h == threads-1)
+    ul = t->n;
   
-    for(uint i = ll; i < ul; i++) {
-      Edge e = g->E[i];
-	
-      if(g->V[e.src].order > g->V[e.tgt].order)
-  	__sync_add_and_fetch(&lower_numb[e.src], (ushort)1);
-      else
-  	__sync_add_and_fetch(&higher_numb[e.src], (ushort)1);
-
-      // NOTE: Used to increase the workload
-      /* for(uint ii = 0; ii < extraOps; ii++) { */
-      /*   __atomic_compare_exchange_n(&ET[i].next, &ET[i].next, NULL, 0, */
-      /* 			      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
-      /* } */
-    }
+  for(idx_t i = ll; i < ul; i++) {
+    lower_numb[i]--;
+    higher_numb[i] -= t->N[i].last - t->N[i].first;
   }
+}
+
+// Successor and weights of each edge of the Euler tour
+static void link_tour(long h, void* arg) {
+  struct psg_args* a = arg;
+  Graph* g = a->g;
+  Tree* t = a->t;
+  idx_t* lower_numb = a->lower_numb;
+  idx_t* higher_numb = a->higher_numb;
+  sidx_t* next = a->next;
+  idx_t* W = a->W;
+  idx_t chk = a->chk;
+  idx_t num_parentheses = 2*t->n;
+  idx_t root_last = a->root_last;
 
-  cilk_for(uint h = 0; h < threads; h++) {
-    uint ll = h*chk;
-    uint ul = ll+chk;
-    if(h == 0)
-      ll = 1;
-    if(h == threads-1)
-      ul = t->n;
-    
-    for(uint i = ll; i < ul; i++) {
-      lower_numb[i]--;
-      higher_numb[i] -= t->N[i].last - t->N[i].first;
+  idx_t ll = h*chk;
+  idx_t ul = ll+chk;
+  if(h == threads-1)
+    ul = num_parentheses-2;
+
+  for(idx_t i = ll; i < ul; i++) {
+
+    /* // NOTE: Used to increase the workload */
+    /* for(uint ii = 0; ii < extraOps; ii++) { */
+    /* 	__atomic_compare_exchange_n(&next[i], &next[i], NULL, 0, */
+    /* 				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
+    /* } */
+
+    Edge e = t->E[i];
+    Node tgt = t->N[e.tgt];
+
+    // Forward edge
+    if(g->V[e.src].order < g->V[e.tgt].order) {
+	W[2*i] = lower_numb[t->E[i].tgt]+1;
+	W[2*i+1] = 1;
+
+	// Leaf
+      if(tgt.first == tgt.last)
+	  next[i] = e.p_tgt;
+      else // Connect to the first child of the tgt node
+	  next[i] = tgt.first+1;
     }
-  }
+    else { // Backward edge
+	W[2*i] = higher_numb[t->E[i].src]+1;
+	W[2*i+1] = 1;
+	// Root
+	if((e.tgt == 0) && (e.p_tgt == root_last)) {
+	  next[i] = 0;
+	  continue;
+	}
 
-  uint root_last = t->N[0].last;
-
-  chk = num_parentheses/threads;
-  cilk_for(uint h = 0; h < threads; h++) {
-    uint ll = h*chk;
-    uint ul = ll+chk;
-    if(h == threads-1)
-      ul = num_parentheses-2;
-
-    for(uint i = ll; i < ul; i++) {
-
-      /* // NOTE: Used to increase the workload */
-      /* for(uint ii = 0; ii < extraOps; ii++) { */
-      /* 	__atomic_compare_exchange_n(&ET[i].next, &ET[i].next, NULL, 0, */
-      /* 				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
-      /* } */
-
-      Edge e = t->E[i];
-      Node src = t->N[e.src];
-      Node tgt = t->N[e.tgt];
-
-      // Forward edge
-      if(g->V[e.src].order < g->V[e.tgt].order) {
-  	ET2[i].value = 1;
-  	ET[i].rank = lower_numb[t->E[i].tgt]+1;
-  	ET2[i].rank = 1;
-
-  	// Leaf
-        if(tgt.first == tgt.last) {
-  	  ET[i].next = e.p_tgt;
-  	  ET2[i].next = e.p_tgt;
-  	}
-        else { // Connect to the first child of the tgt node
-  	  ET[i].next = tgt.first+1;
-  	  ET2[i].next = tgt.first+1;
-  	}
-      }
-      else { // Backward edge
-  	ET2[i].value = 0;
-  	ET[i].rank = higher_numb[t->E[i].src]+1;
-  	ET2[i].rank = 1;
-  	// Root
-  	if((e.tgt == 0) && (e.p_tgt == root_last)) {
-  	  ET[i].next = 0;
-  	  ET2[i].next = 0;
-  	  continue;
-  	}
-
-  	if(e.p_tgt == t->N[e.tgt].last) {
-  	  ET[i].next = t->N[e.tgt].first; // Parent of the tgt node
-  	  ET2[i].next = t->N[e.tgt].first; // Parent of the tgt node
-  	}
-  	else {
-  	  ET[i].next = e.p_tgt+1; // Parent of the tgt node
-  	  ET2[i].next = e.p_tgt+1; // Parent of the tgt node
-  	}
-      }
+	if(e.p_tgt == t->N[e.tgt].last)
+	  next[i] = t->N[e.tgt].first; // Parent of the tgt node
+	else
+	  next[i] = e.p_tgt+1; // Parent of the tgt node
     }
   }
+}
+
+// Position of each edge in the Euler tour
+static void invert_tour(long h, void* arg) {
+  struct psg_args* a = arg;
+  idx_t* W = a->W;
+  idx_t* tour = a->tour;
+  idx_t tour_size = a->tour_size;
+  idx_t chk = a->chk;
+
+  idx_t ll = h*chk;
+  idx_t ul = ll+chk;
+  if(h == threads-1)
+    ul = tour_size;
 
-  parallel_list_ranking(ET, num_parentheses-2);
-  parallel_list_ranking(ET2, num_parentheses-2);
-
-  chk = num_parentheses/threads;
-  cilk_for(uint h = 0; h < threads; h++) {
-    uint ll = h*chk;
-    uint ul = ll+chk;
-    if(h == threads-1)
-      ul = num_parentheses-2;
-    
-    for(uint i = ll; i < ul; i++) {
-
-      /* // NOTE: Used to increase the workload */
-      /* for(uint ii = 0; ii < extraOps; ii++) { */
-      /* 	__atomic_compare_exchange_n(&ET[i].next, &ET[i].next, NULL, 0, */
-      /* 				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
-      /* } */
-
-      parallel_or_bit_array_set_bit(S1,ET[i].rank+1);
-      if(ET2[i].value)
-	parallel_or_bit_array_set_bit(S2,ET2[i].rank+1);
-      else {
-	uint ll = ET[i].rank-ET2[i].rank;
-	uint ul = ll + higher_numb[t->E[i].src];
-	for(uint j=ll; j < ul; j++)
-	  parallel_or_bit_array_set_bit(S3,j);
-      }
+  for(idx_t i = ll; i < ul; i++)
+    tour[W[2*i+1]] = i;
+}
+
+// Emit the bits of S1, S2 and S3 of a range of the Euler tour
+static void emit_range(long h, void* arg) {
+  struct psg_args* a = arg;
+  Graph* g = a->g;
+  Tree* t = a->t;
+  idx_t* higher_numb = a->higher_numb;
+  idx_t* W = a->W;
+  idx_t* tour = a->tour;
+  idx_t tour_size = a->tour_size;
+  BIT_ARRAY* S1 = a->S1;
+  BIT_ARRAY* S2 = a->S2;
+  BIT_ARRAY* S3 = a->S3;
+  word_t* heads = a->heads;
+  word_addr_t* firsts = a->firsts;
+  idx_t chk = a->chk;
+
+  idx_t ll = h*chk;
+  idx_t ul = ll+chk;
+  if(h == threads-1)
+    ul = tour_size;
+
+  if(ll < ul) {
+    idx_t first = tour[ll];
+    struct bit_writer w1, w2, w3;
+    bit_writer_init(&w1, S1, W[2*first]+1);
+    bit_writer_init(&w2, S2, ll+1);
+    bit_writer_init(&w3, S3, W[2*first]-W[2*first+1]);
+
+    for(idx_t p = ll; p < ul; p++) {
+
+	/* // NOTE: Used to increase the workload */
+	/* for(uint ii = 0; ii < extraOps; ii++) { */
+	/* 	__atomic_compare_exchange_n(&next[p], &next[p], NULL, 0, */
+	/* 				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ); */
+	/* } */
+
+	idx_t i = tour[p];
+	Edge e = t->E[i];
+
+	bit_writer_set(&w1, W[2*i]+1);
+	if(g->V[e.src].order < g->V[e.tgt].order) // Forward edge
+	  bit_writer_set(&w2, p+1);
+	else {
+	  idx_t ll = W[2*i]-W[2*i+1];
+	  bit_writer_fill(&w3, ll, ll + higher_numb[e.src]);
+	}
     }
+
+    bit_writer_close(&w1, &firsts[3*h], &heads[3*h]);
+    bit_writer_close(&w2, &firsts[3*h+1], &heads[3*h+1]);
+    bit_writer_close(&w3, &firsts[3*h+2], &heads[3*h+2]);
   }
+}
+
+succ_graph* parallel_succinct_graph(Graph* g, Tree* t) {
+  // Section 0
+  succ_graph* sg = init_succ_graph(g);
+
+  idx_t num_parentheses = 2*t->n;
+  idx_t num_brackets = 2*(g->m - t->n + 1);
+  idx_t num_total = num_parentheses + num_brackets;
+
+  BIT_ARRAY* S1 = bit_array_create(num_total);
+  BIT_ARRAY* S2 = bit_array_create(num_parentheses);
+  BIT_ARRAY* S3 = bit_array_create(num_brackets);
+
+  idx_t* lower_numb = calloc(t->n,sizeof(idx_t));
+  idx_t* higher_numb = calloc(t->n,sizeof(idx_t));
+
+  // Euler tour of the spanning tree. Both S1 and S2 are computed by ranking
+  // the same list, so the weights of each edge are stored together:
+  // W[2*i] is the weight/rank of the edge i in S1 and W[2*i+1] in S2
+  sidx_t* next = malloc((num_parentheses-2)*sizeof(sidx_t));
+  idx_t* W = malloc(2*(num_parentheses-2)*sizeof(idx_t));
+
+  struct psg_args a = {.g = g, .t = t, .lower_numb = lower_numb,
+		       .higher_numb = higher_numb, .next = next, .W = W};
+  a.chk = 2*g->m/threads;
+
+  parallel_for(0, threads, count_edges, &a);
+
+  a.chk = t->n/threads;
+  parallel_for(0, threads, adjust_counts, &a);
+
+  a.root_last = t->N[0].last;
+
+  a.chk = num_parentheses/threads;
+  parallel_for(0, threads, link_tour, &a);
+
+  parallel_multi_list_ranking(next, W, 2, num_parentheses-2);
+
+  /*
+   * Emission of S1, S2 and S3. The ranks in S2 are the positions of the edges
+   * in the Euler tour, so the array 'next' (no longer needed) is reused to
+   * store the tour. Each thread emits a contiguous range of the tour, which
+   * maps to contiguous ranges of S1, S2 and S3. Thus, each thread writes
+   * whole words without atomic operations. Only the first word of each range
+   * can be shared with the previous thread, so it is merged at the end.
+   */
+  a.tour_size = num_parentheses-2;
+  a.tour = (idx_t*)next;
+
+  a.chk = a.tour_size/threads;
+  parallel_for(0, threads, invert_tour, &a);
+
+  // Threads with an empty range (tour_size < threads) leave their entries at
+  // 0, so merging them is a no-op
+  word_t* heads = calloc(3*threads, sizeof(word_t));
+  word_addr_t* firsts = calloc(3*threads, sizeof(word_addr_t));
+  a.S1 = S1;
+  a.S2 = S2;
+  a.S3 = S3;
+  a.heads = heads;
+  a.firsts = firsts;
+
+  parallel_for(0, threads, emit_range, &a);
+
+  // Merge the first word of each range
+  for(int h = 0; h < threads; h++) {
+    S1->words[firsts[3*h]] |= heads[3*h];
+    S2->words[firsts[3*h+1]] |= heads[3*h+1];
+    S3->words[firsts[3*h+2]] |= heads[3*h+2];
+  }
+
+  free(heads);
+  free(firsts);
+
   bit_array_set_bit(S1,0);
   bit_array_set_bit(S1,num_total-1);
   bit_array_set_bit(S2,0);
 
   free(lower_numb);
   free(higher_numb);
-  free(ET);
-  free(ET2);
+  free(next);
+  free(W);
 
   sg->S1 = st_create_emM(S1, bit_array_length(S1));
   sg->S2 = st_create_emM(S2, bit_array_length(S2));
   sg->S3 = st_create_emM(S3, bit_array_length(S3));
 
+#ifdef PIONEERS
+  // The navigation matches parentheses of S2 and brackets of S3, whose
+  // matches are often in a distant chunk
+  st_build_pioneers(sg->S2);
+  st_build_pioneers(sg->S3);
+#endif
+
   return sg;
 }
 
+/*
+ * Navigation. A vertex is mapped to its parentheses in S2 with select/rank
+ * and a parenthesis of S2 to its position in S1 with select, since the
+ * parentheses are the ones of S1. The zeros of S1 are the brackets of S3, so
+ * the brackets of a vertex are the run of zeros that follows each of its
+ * parentheses in S1. A non-tree neighbor is the owner of the matching bracket.
+ */
+
+// Vertex of the parenthesis at position p of S2
+static inline idx_t s2_vertex(succ_graph* sg, pos_t p) {
+  if(st_get_bit(sg->S2, p) == 0)
+    p = find_open(sg->S2, p);
+
+  return rank_1(sg->S2, p) - 1;
+}
+
+// Brackets that follow the parenthesis at position p of S2. It returns the
+// number of brackets and stores the position of the first one in S3 in first
+static inline idx_t s2_brackets(succ_graph* sg, pos_t p, pos_t* first) {
+  pos_t q = select_1(sg->S1, p+1);
+  pos_t next = select_1(sg->S1, p+2);
+
+  if(next < 0) // Last parenthesis
+    next = sg->S1->n;
+  *first = q + 1 - (p+1); // Zeros in S1[0,q]
+  return next - q - 1;
+}
+
+// Owner of the bracket at position x of S3, the vertex of the closest
+// parenthesis to its left in S1
+static inline idx_t s3_owner(succ_graph* sg, pos_t x) {
+  pos_t q = select_0(sg->S1, x+1);
+
+  return s2_vertex(sg, rank_1(sg->S1, q) - 1);
+}
+
+// Neighbor of a vertex through its bracket at position x of S3
+static inline idx_t s3_neighbor(succ_graph* sg, pos_t x) {
+  if(st_get_bit(sg->S3, x))
+    return s3_owner(sg, find_close(sg->S3, x));
+
+  return s3_owner(sg, find_open(sg->S3, x));
+}
+
+idx_t sg_degree(succ_graph* sg, idx_t v) {
+  pos_t open = select_1(sg->S2, v+1);
+  pos_t close = find_close(sg->S2, open);
+  pos_t first;
+  idx_t deg = 0;
+
+  if(v > 0)
+    deg = 1 + s2_brackets(sg, open, &first) + s2_brackets(sg, close, &first);
+
+  // Children
+  for(pos_t c = open+1; c < close; c = find_close(sg->S2, c)+1)
+    deg++;
+
+  return deg;
+}
+
+idx_t sg_neighbors(succ_graph* sg, idx_t v, idx_t* N) {
+  pos_t open = select_1(sg->S2, v+1);
+  pos_t close = find_close(sg->S2, open);
+  pos_t first;
+  idx_t deg = 0, num;
+
+  if(v > 0) {
+    N[deg++] = s2_vertex(sg, enclose(sg->S2, open)); // Parent
+    num = s2_brackets(sg, open, &first);
+    for(idx_t i = 0; i < num; i++)
+      N[deg++] = s3_neighbor(sg, first+i);
+  }
+
+  for(pos_t c = open+1; c < close; c = find_close(sg->S2, c)+1)
+    N[deg++] = rank_1(sg->S2, c) - 1;
+
+  if(v > 0) {
+    num = s2_brackets(sg, close, &first);
+    for(idx_t i = 0; i < num; i++)
+      N[deg++] = s3_neighbor(sg, first+i);
+  }
+
+  return deg;
+}
+
+int sg_adjacent(succ_graph* sg, idx_t u, idx_t v) {
+  if(u == v)
+    return 0;
+  if(u > v) { // u is the lower vertex
+    idx_t tmp = u;
+    u = v;
+    v = tmp;
+  }
+
+  // Tree edge: u is the parent of v
+  pos_t open_v = select_1(sg->S2, v+1);
+  if(s2_vertex(sg, enclose(sg->S2, open_v)) == u)
+    return 1;
+
+  // Non-tree edge: a bracket after the opening parenthesis of v matches a
+  // bracket after the closing parenthesis of u. The brackets of v match
+  // brackets in decreasing order of position, so the run is binary searched
+  pos_t open_u = select_1(sg->S2, u+1);
+  pos_t u_first, v_first;
+  idx_t u_num = s2_brackets(sg, find_close(sg->S2, open_u), &u_first);
+  idx_t v_num = s2_brackets(sg, open_v, &v_first);
+
+  if(u == 0 || u_num == 0)
+    return 0;
+
+  pos_t lo = v_first, hi = v_first + v_num - 1;
+  while(lo <= hi) {
+    pos_t mid = lo + (hi-lo)/2;
+    pos_t x = find_open(sg->S3, mid);
+    if(x < u_first)
+      hi = mid-1;
+    else if(x >= u_first + (pos_t)u_num)
+      lo = mid+1;
+    else
+      return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Half-edges. Around a vertex v (other than v1), its half-edges in ccw order
+ * are the closing parenthesis of v (to the parent), the brackets after the
+ * opening parenthesis of v, the opening parentheses of its children and the
+ * brackets after the closing parenthesis of v. Around v1, they are the opening
+ * parentheses of its children
+ */
+
+#define S1_BIT(sg, i) st_get_bit((sg)->S1, (i))
+#define S2_BIT(sg, i) st_get_bit((sg)->S2, (i))
+#define S3_BIT(sg, i) st_get_bit((sg)->S3, (i))
+
+// Position in S1 of the parenthesis at position p of S2
+static inline pos_t s1_paren(succ_graph* sg, pos_t p) {
+  return select_1(sg->S1, p+1);
+}
+
+// Half-edge that follows the children of the vertex whose closing parenthesis
+// is at position c of S1: its first higher bracket or, otherwise, c
+static inline idx_t after_children(succ_graph* sg, pos_t c) {
+  return S1_BIT(sg, c+1) ? c : c+1;
+}
+
+// Half-edge that precedes the higher brackets of the vertex whose closing
+// parenthesis is at position c of S1 (p in S2): its last child, its last lower
+// bracket or c
+static inline idx_t before_higher(succ_graph* sg, pos_t c, pos_t p) {
+  if(S2_BIT(sg, p-1) == 0) // Last child
+    return s1_paren(sg, find_open(sg->S2, p-1));
+
+  return S1_BIT(sg, c-1) ? c : c-1;
+}
+
+idx_t sg_firstE(succ_graph* sg, idx_t v) {
+  if(v == 0)
+    return 1; // v2, the first child of v1
+
+  return s1_paren(sg, find_close(sg->S2, select_1(sg->S2, v+1)));
+}
+
+idx_t sg_lastE(succ_graph* sg, idx_t v) {
+  return sg_prevE(sg, sg_firstE(sg, v));
+}
+
+idx_t sg_nextE(succ_graph* sg, idx_t e) {
+  if(S1_BIT(sg, e)) {
+    pos_t p = rank_1(sg->S1, e) - 1;
+
+    if(S2_BIT(sg, p)) { // To a child: the next child or the higher brackets
+      p = find_close(sg->S2, p) + 1;
+      if(p == (pos_t)sg->S2->n - 1) // Last child of v1
+	return 1;
+      return S2_BIT(sg, p) ? (idx_t)s1_paren(sg, p) :
+	after_children(sg, s1_paren(sg, p));
+    }
+
+    // To the parent: the first lower bracket, the first child or the higher
+    // brackets
+    pos_t q = s1_paren(sg, find_open(sg->S2, p)) + 1;
+    return (q != (pos_t)e) ? (idx_t)q : after_children(sg, e);
+  }
+
+  if(S3_BIT(sg, e - rank_1(sg->S1, e)) == 0) { // Lower bracket
+    if(S1_BIT(sg, e+1) == 0 || S2_BIT(sg, rank_1(sg->S1, e+1) - 1))
+      return e+1; // The next lower bracket or the first child
+    return after_children(sg, e+1);
+  }
+
+  // Higher bracket: the next one or the closing parenthesis to its left
+  if(S1_BIT(sg, e+1) == 0)
+    return e+1;
+  return select_1(sg->S1, rank_1(sg->S1, e));
+}
+
+idx_t sg_prevE(succ_graph* sg, idx_t e) {
+  if(S1_BIT(sg, e)) {
+    pos_t p = rank_1(sg->S1, e) - 1;
+
+    if(S2_BIT(sg, p)) { // To a child
+      if(S2_BIT(sg, p-1) == 0) // Previous sibling
+	return s1_paren(sg, find_open(sg->S2, p-1));
+      if(p == 1) // First child of v1
+	return s1_paren(sg, find_open(sg->S2, sg->S2->n - 2));
+      if(S1_BIT(sg, e-1) == 0) // Last lower bracket
+	return e-1;
+      return s1_paren(sg, find_close(sg->S2, p-1));
+    }
+
+    // To the parent: the last higher bracket or the ones before them
+    if(S1_BIT(sg, e+1) == 0)
+      return s1_paren(sg, p+1) - 1;
+    return before_higher(sg, e, p);
+  }
+
+  if(S1_BIT(sg, e-1) == 0)
+    return e-1;
+
+  // First bracket after a parenthesis
+  pos_t p = rank_1(sg->S1, e-1) - 1;
+  if(S2_BIT(sg, p)) // Lower bracket: the closing parenthesis of its vertex
+    return s1_paren(sg, find_close(sg->S2, p));
+  return before_higher(sg, e-1, p);
+}
+
+idx_t sg_complement(succ_graph* sg, idx_t e) {
+  if(S1_BIT(sg, e)) {
+    pos_t p = rank_1(sg->S1, e) - 1;
+    p = S2_BIT(sg, p) ? find_close(sg->S2, p) : find_open(sg->S2, p);
+    return s1_paren(sg, p);
+  }
+
+  pos_t x = e - rank_1(sg->S1, e);
+  x = S3_BIT(sg, x) ? find_close(sg->S3, x) : find_open(sg->S3, x);
+  return select_0(sg->S1, x+1);
+}
+
+idx_t sg_source(succ_graph* sg, idx_t e) {
+  pos_t p = rank_1(sg->S1, e) - 1;
+
+  if(S1_BIT(sg, e) && S2_BIT(sg, p)) // To a child
+    return s2_vertex(sg, enclose(sg->S2, p));
+  return s2_vertex(sg, p);
+}
+
+idx_t sg_target(succ_graph* sg, idx_t e) {
+  return sg_source(sg, sg_complement(sg, e));
+}
+
+idx_t sg_nextF(succ_graph* sg, idx_t e) {
+  return sg_prevE(sg, sg_complement(sg, e));
+}
@@ -42,3 +42,59 @@ typedef struct succ_graph_t succ_graph;
 succ_graph* parallel_succinct_graph(Graph*, Tree*);
 void print_succ_graph(succ_graph*);
 void free_succ_graph(succ_graph*);
+
+/*
+ * Navigation. The vertices are identified by the preorder rank of their nodes
+ * in the spanning tree encoded in S2 (v1 is the vertex 0). Around a vertex v,
+ * the neighbors appear in counterclockwise order as the parent of v, the non-tree
+ * neighbors that precede v in preorder (the brackets after the opening
+ * parenthesis of v in S1), the children of v and the non-tree neighbors that
+ * follow v (the brackets after the closing parenthesis of v)
+ */
+
+// It returns the number of neighbors of the vertex v
+idx_t sg_degree(succ_graph*, idx_t v);
+
+// It stores the neighbors of the vertex v in counterclockwise order, starting
+// with its parent, in N (of size sg_degree(v) at least). It returns the number
+// of neighbors
+idx_t sg_neighbors(succ_graph*, idx_t v, idx_t* N);
+
+// It returns 1 if the vertices u and v are adjacent and 0 otherwise
+int sg_adjacent(succ_graph*, idx_t u, idx_t v);
+
+/*
+ * Half-edges. A half-edge is identified by a position of S1 in [1,2m]: the
+ * opening parenthesis of a vertex v is the half-edge from the parent of v to v,
+ * its closing parenthesis is the half-edge from v to its parent and a bracket
+ * is the half-edge from its owner (the vertex of the closest parenthesis to its
+ * left) to the owner of the matching bracket. The operations mirror the ones of
+ * defs.h, but nextE/prevE wrap around the vertex
+ */
+
+// Given a vertex, it returns its first half-edge (the one to its parent, or to
+// v2 for v1)
+idx_t sg_firstE(succ_graph*, idx_t v);
+
+// Given a vertex, it returns its last half-edge in ccw order
+idx_t sg_lastE(succ_graph*, idx_t v);
+
+// Given a half-edge, it returns the next half-edge with the same source in ccw
+// order
+idx_t sg_nextE(succ_graph*, idx_t e);
+
+// Given a half-edge, it returns the previous half-edge with the same source in
+// ccw order
+idx_t sg_prevE(succ_graph*, idx_t e);
+
+// Given a half-edge, it returns the complement half-edge (its twin)
+idx_t sg_complement(succ_graph*, idx_t e);
+
+// Given a half-edge, it returns its source vertex
+idx_t sg_source(succ_graph*, idx_t e);
+
+// Given a half-edge, it returns its target vertex
+idx_t sg_target(succ_graph*, idx_t e);
+
+// Given a half-edge, it returns the next half-edge of the face to its left
+idx_t sg_nextF(succ_graph*, idx_t e);
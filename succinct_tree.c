@@ -29,15 +29,28 @@
 /* #include <stdio.h> */
 /* #include <stdlib.h> */
 /* #include <math.h> */
+#include <string.h>
 
 #include "lookup_tables.h"
-#include "binary_trees.h"
+#include "kary_trees.h"
 #include "succinct_tree.h"
 #include "bit_array.h"
 #include "util.h"
 
 #include "malloc_count.h"
 
+// The in-chunk scans use AVX2 or SSSE3 kernels when the CPU supports them
+#if defined(__x86_64__) && defined(ARCH64)
+#define SIMD_SCAN
+#endif
+
+#if defined(__BMI2__) || defined(SIMD_SCAN)
+#include <immintrin.h> // _pdep_u64, SIMD kernels
+#endif
+
+
+// Universal tables (lookup_tables_data.c, generated by gen_lookup_tables)
+static const lookup_table* const T = &lookup_tables;
 
 #define min(a,b) \
   ({ __typeof__ (a) _a = (a); \
@@ -50,36 +63,299 @@
     _a > _b ? _a : _b; })
 
 
+// Number of ones of a word of the bit array
+#define popcount_word(w) __builtin_popcountll((unsigned long long)(w))
+
+/*
+ * Rank directory: a superblock has 2^16 bits and a block has 512 bits (a cache
+ * line), so the counts relative to a superblock fit in 16 bits
+ */
+#define RANK_SB_LOG 16
+#define RANK_B_LOG 9
+#define RANK_B_WORDS (1 << (RANK_B_LOG-logW)) // Words per block
+
+// One select sample every 2^12 ones (zeros). Since a block has 512 bits, each
+// block contains at most one sample
+#define SELECT_LOG 12
+
+// Chunks per superblock of the pioneer directory, so the number of pioneers
+// before a chunk of the superblock fits in 16 bits
+#define PIONEER_SB_CHUNKS ((1 << 16)/RMMT_S)
+
+// Number of ones before the block b
+static inline bit_index_t block_rank(rmMt* st, bit_index_t b) {
+  return st->rank_sb[b >> (RANK_SB_LOG-RANK_B_LOG)] + st->rank_b[b];
+}
+
+#define CACHE_LINE 64 // Bytes
+
+#ifdef RMMT_BLOCKS
+
+// Excess value at the end of the chunk c-1 (0 for the first chunk)
+static inline pos_t excess_before(rmMt* st, bit_index_t c) {
+  return st->blocks[c].e;
+}
+
+// Excess value at the end of the chunk c
+static inline pos_t chunk_excess(rmMt* st, bit_index_t c) {
+  if(c+1 < st->num_chunks)
+    return st->blocks[c+1].e;
+
+  // The last chunk has no successor
+  bit_index_t ones = 0;
+  for(word_addr_t w = 0; w < RMMT_WORDS; w++)
+    ones += popcount_word(st->blocks[c].bits[w]);
+  return st->blocks[c].e + 2*(pos_t)ones - (pos_t)(st->n - c*RMMT_S);
+}
+
+// Minimum and maximum excess values of the chunk c, relative to the excess
+// value before it
+#define leaf_min(st, c) ((st)->blocks[c].m)
+#define leaf_max(st, c) ((st)->blocks[c].M)
+
+#else
+
+// One absolute excess sample every 2^14 bits, so the excess values relative to
+// the samples (and to the beginning of a chunk) fit in 16 bits
+#define E_SAMPLE_LOG 14
+
+// Excess value at the end of the chunk c
+static inline pos_t chunk_excess(rmMt* st, bit_index_t c) {
+  return st->e_sample[(c*RMMT_S) >> E_SAMPLE_LOG] + st->leaves[c].e;
+}
+
+// Excess value at the end of the chunk c-1 (0 for the first chunk)
+static inline pos_t excess_before(rmMt* st, bit_index_t c) {
+  return c ? chunk_excess(st, c-1) : 0;
+}
+
+#define leaf_min(st, c) ((st)->leaves[c].m)
+#define leaf_max(st, c) ((st)->leaves[c].M)
+
+#endif
+
+// Minimum and maximum excess values of a node of the min-max tree
+static inline pos_t node_min(rmMt* st, long node) {
+  if(node < (long)st->internal_nodes)
+    return st->nodes[node].m;
+
+  bit_index_t c = node - st->internal_nodes;
+  return excess_before(st, c) + leaf_min(st, c);
+}
+
+static inline pos_t node_max(rmMt* st, long node) {
+  if(node < (long)st->internal_nodes)
+    return st->nodes[node].M;
+
+  bit_index_t c = node - st->internal_nodes;
+  return excess_before(st, c) + leaf_max(st, c);
+}
+
+/*
+ * SIMD kernels for the in-chunk scans. They process groups of 32 bits that
+ * start at a multiple of 32: the bits are expanded to +1/-1 bytes and a prefix
+ * sum gives the excess values of the group, which are compared with the
+ * desired value at once. The kernel is chosen at run time (see
+ * init_scan_kernels). Without SIMD support the scans only use the tables
+ */
+
+// Scan num groups from the position j of the chunk whose word j/64 is words[0].
+// e is the excess value before (after) the groups and it is updated
+typedef pos_t (*groups_scan)(const word_t* words, pos_t j, pos_t num,
+			     pos_t* e, pos_t d);
+
+static groups_scan fwd_groups = NULL;
+static groups_scan bwd_groups = NULL;
+
+#ifdef SIMD_SCAN
+
+// Group g of 32 bits, counted from the group of words[0] that contains j
+#define GROUP(words, g) ((uint32_t)((words)[(g) >> 1] >> (32*((g) & 1))))
+
+// Excess values of the positions of a group (16 bits with SSSE3), relative to
+// the excess value before the group
+__attribute__((target("avx2")))
+static inline __m256i prefix_excess_avx2(uint32_t bits) {
+  const __m256i byte_of = _mm256_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1,
+					   2,2,2,2,2,2,2,2, 3,3,3,3,3,3,3,3);
+  const __m256i bit_of = _mm256_set1_epi64x(0x8040201008040201LL);
+  __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(bits), byte_of);
+  v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bit_of), bit_of);
+  v = _mm256_sub_epi8(_mm256_set1_epi8(-1), _mm256_add_epi8(v, v)); // +1 or -1
+
+  v = _mm256_add_epi8(v, _mm256_slli_si256(v, 1));
+  v = _mm256_add_epi8(v, _mm256_slli_si256(v, 2));
+  v = _mm256_add_epi8(v, _mm256_slli_si256(v, 4));
+  v = _mm256_add_epi8(v, _mm256_slli_si256(v, 8));
+  // The shifts do not cross the 128-bit lanes, so the high lane gets the
+  // excess of the low one
+  __m256i c = _mm256_shuffle_epi8(v, _mm256_set1_epi8(15));
+  return _mm256_add_epi8(v, _mm256_permute2x128_si256(c, c, 0x08));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i prefix_excess_ssse3(uint16_t bits) {
+  const __m128i byte_of = _mm_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1);
+  const __m128i bit_of = _mm_set1_epi64x(0x8040201008040201LL);
+  __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(bits), byte_of);
+  v = _mm_cmpeq_epi8(_mm_and_si128(v, bit_of), bit_of);
+  v = _mm_sub_epi8(_mm_set1_epi8(-1), _mm_add_epi8(v, v));
+
+  v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+  v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+  v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+  return _mm_add_epi8(v, _mm_slli_si128(v, 8));
+}
+
+// First position with excess value d
+__attribute__((target("avx2")))
+static pos_t fwd_groups_avx2(const word_t* words, pos_t j, pos_t num,
+			     pos_t* e, pos_t d) {
+  long h = (j >> 5) & 1;
+  for(long g = h; g < h+num; g++, j += 32) {
+    __m256i v = prefix_excess_avx2(GROUP(words, g));
+    pos_t desired = d - *e;
+    if(desired >= -32 && desired <= 32) {
+      uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(desired)));
+      if(eq)
+	return j + __builtin_ctz(eq);
+    }
+    *e += (int8_t)_mm256_extract_epi8(v, 31);
+  }
+  return -1;
+}
+
+__attribute__((target("ssse3")))
+static pos_t fwd_groups_ssse3(const word_t* words, pos_t j, pos_t num,
+			      pos_t* e, pos_t d) {
+  long h = (j >> 5) & 1;
+  for(long g = h; g < h+num; g++) {
+    uint32_t bits = GROUP(words, g);
+    for(int half = 0; half < 2; half++, j += 16, bits >>= 16) {
+      __m128i v = prefix_excess_ssse3(bits);
+      pos_t desired = d - *e;
+      if(desired >= -16 && desired <= 16) {
+	uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(desired)));
+	if(eq)
+	  return j + __builtin_ctz(eq);
+      }
+      *e += (int8_t)(_mm_extract_epi16(v, 7) >> 8);
+    }
+  }
+  return -1;
+}
+
+// Last position with excess value d. j is the last position of the first
+// group. As in bwd_scan, the position before a group is reported when it has
+// excess value d
+__attribute__((target("avx2")))
+static pos_t bwd_groups_avx2(const word_t* words, pos_t j, pos_t num,
+			     pos_t* e, pos_t d) {
+  long h = (j >> 5) & 1;
+  for(long g = h; g > h-num; g--, j -= 32) {
+    __m256i v = prefix_excess_avx2(GROUP(words, g));
+    pos_t before = *e - (int8_t)_mm256_extract_epi8(v, 31);
+    pos_t desired = d - before;
+    if(desired >= -32 && desired <= 32) {
+      uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(desired)));
+      if(eq)
+	return j - __builtin_clz(eq);
+      if(desired == 0)
+	return j - 32;
+    }
+    *e = before;
+  }
+  return -2;
+}
+
+__attribute__((target("ssse3")))
+static pos_t bwd_groups_ssse3(const word_t* words, pos_t j, pos_t num,
+			      pos_t* e, pos_t d) {
+  long h = (j >> 5) & 1;
+  for(long g = h; g > h-num; g--) {
+    uint32_t bits = GROUP(words, g);
+    for(int half = 0; half < 2; half++, j -= 16, bits <<= 16) {
+      __m128i v = prefix_excess_ssse3(bits >> 16);
+      pos_t before = *e - (int8_t)(_mm_extract_epi16(v, 7) >> 8);
+      pos_t desired = d - before;
+      if(desired >= -16 && desired <= 16) {
+	uint32_t eq = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(desired)));
+	if(eq)
+	  return j - (__builtin_clz(eq) - 16);
+	if(desired == 0)
+	  return j - 16;
+      }
+      *e = before;
+    }
+  }
+  return -2;
+}
+
+#undef GROUP
+
+#endif // SIMD_SCAN
+
+// Run once at program start, so the kernels are never chosen concurrently
+__attribute__((constructor))
+static void init_scan_kernels() {
+#ifdef SIMD_SCAN
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) {
+    fwd_groups = fwd_groups_avx2;
+    bwd_groups = bwd_groups_avx2;
+  }
+  else if(__builtin_cpu_supports("ssse3")) {
+    fwd_groups = fwd_groups_ssse3;
+    bwd_groups = bwd_groups_ssse3;
+  }
+#endif
+}
+
 /* ASSUMPTIONS:
- * - s = 256 (8 bits) (Following the sdsl/libcds implementations)
- * - k = 2 (Min-max tree will be a binary tree)
+ * - s = RMMT_S, 256 by default (Following the sdsl/libcds implementations)
+ * - k = RMMT_K, 8 by default (4 with IDX64, the children of a node fill a
+ *   cache line)
  * - Each thread has to process at least one chunk with parentheses (Problem with n <= s)
  */
 
-unsigned int s = 256; // Chunk size
-unsigned int k = 2; // arity of the min-max tree
-int16_t* e_prime; // num_chunks leaves (it does not need internal nodes)
-int16_t* m_prime; // num_chunks leaves plus offset internal nodes
-int16_t* M_prime; // num_chunks leaves plus offset internal nodes
-int16_t* n_prime; // num_chunks leaves plus offset internal nodes
-
 rmMt* init_rmMt(unsigned long n) {
   rmMt* st = (rmMt*)malloc(sizeof(rmMt));
-  st->s = 256;
-  st->k = 2;
+  st->s = RMMT_S;
+  st->k = RMMT_K;
   st->n = n;
-  st->num_chunks = ceil((double)n/st->s);
-  st->height = ceil(log(st->num_chunks)/log(st->k)); // heigh = logk(num_chunks), Heigh of the min-max tree
-  st->internal_nodes = (pow(st->k,st->height)-1)/(st->k-1); // Number of internal nodes;
+  st->num_chunks = (n + RMMT_S - 1)/RMMT_S;
+
+  // height = ceil(logk(num_chunks)), Heigh of the min-max tree
+  st->height = 0;
+  st->internal_nodes = 0; // Number of internal nodes
+  for(bit_index_t cap = 1; cap < st->num_chunks; cap *= RMMT_K) {
+    st->internal_nodes += cap;
+    st->height++;
+  }
+
+  st->pioneer_sb = NULL;
+  st->pioneer_first = NULL;
+  st->pioneers = NULL;
 
   return st;
 }
 
 void free_rmMt(rmMt* st) {
-  free(st->e_prime);
-  free(st->m_prime);
-  free(st->M_prime);
+#ifdef RMMT_BLOCKS
+  free(st->blocks_mem);
+#else
+  free(st->e_sample);
+  free(st->leaves);
   bit_array_free(st->B);
+#endif
+  free(st->nodes_mem);
+  free(st->rank_sb);
+  free(st->rank_b);
+  free(st->select1_s);
+  free(st->select0_s);
+  free(st->pioneer_sb);
+  free(st->pioneer_first);
+  free(st->pioneers);
   free(st);
 }
 
@@ -87,76 +363,107 @@ void print_rmMt(rmMt* st) {
   fprintf(stderr, "Chunk size: %u\n", st->s);
   fprintf(stderr, "Arity: %u\n", st->k);
   fprintf(stderr, "Number of parentheses: %lu\n", st->n);
-  fprintf(stderr, "Number of chunks (leaves): %u\n", st->num_chunks);
+  fprintf(stderr, "Number of chunks (leaves): %lu\n", (unsigned long)st->num_chunks);
   fprintf(stderr, "Height: %u\n", st->height);
-  fprintf(stderr, "Number of internal nodes: %u\n", st->internal_nodes);
+  fprintf(stderr, "Number of internal nodes: %lu\n",
+	  (unsigned long)st->internal_nodes);
+  if(st->pioneer_first != NULL)
+    fprintf(stderr, "Number of pioneers: %lu\n",
+	    (unsigned long)(st->pioneer_sb[st->num_chunks/PIONEER_SB_CHUNKS] +
+			    st->pioneer_first[st->num_chunks]));
 }
 
-rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n) {
-  rmMt* st = init_rmMt(n);
+// Data shared by the parallel loops of st_create_emM
+struct emM_args {
+  rmMt* st;
+  BIT_ARRAY* B;
+  unsigned long n;
+  pos_t* e_abs; // Absolute excess value at the end of each chunk
+  unsigned int num_threads;
+  bit_index_t chunks_per_thread;
+  int p_level;
+  word_addr_t B_words;
+  bit_index_t num_blocks;
+  word_addr_t num_words;
+  bit_index_t ones;
+};
 
-  //print_rmMt(st);
-  
-  // num_chunks leaves (it does not need internal nodes)
-  st->e_prime = (int16_t*)calloc(st->num_chunks,sizeof(int16_t));
-  // num_chunks leaves plus internal nodes
-  st->m_prime = (int16_t*)calloc(st->num_chunks + st->internal_nodes,sizeof(int16_t));
-  // num_chunks leaves plus internal nodes
-  st->M_prime = (int16_t*)calloc(st->num_chunks + st->internal_nodes,sizeof(int16_t));
-  st->B = B;
-  
-  if(st->s >= n){
-    fprintf(stderr, "Error: Input size is smaller or equal than the chunk size (input size: %lu, chunk size: %u)\n", n, st->s);
-    exit(0);
-  }
-  
-  /*
-   * STEP 2: Computation of arrays e', m', M' and n'
-   */
-  unsigned int num_threads = __cilkrts_get_nworkers();
-  // Each thread works on 'chunks_per_thread' consecutive chunks of B 
-  unsigned int chunks_per_thread = ceil((double)st->num_chunks/num_threads);
+// Prefix computation of the chunks of the thread (step 2.1)
+static void emM_thread_chunks(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  BIT_ARRAY* B = a->B;
+  unsigned long n = a->n;
+  pos_t* e_abs = a->e_abs;
+  unsigned int num_threads = a->num_threads;
+  bit_index_t chunks_per_thread = a->chunks_per_thread;
+  unsigned int thread = i;
 
-  //  printf("Number of threads: %u\n", num_threads);
-  //  printf("Chunks per thread: %u\n", chunks_per_thread);
+  bit_index_t chunk = 0;
+  bit_index_t chunk_limit; // It is possible that the last thread process less chunks
   
-  /*
-   * STEP 2.1: Each thread computes the prefix computation in a range of the bit array
-   */
+  if((thread == num_threads - 1) && (st->num_chunks%chunks_per_thread != 0))
+    chunk_limit = st->num_chunks%chunks_per_thread;
+  else
+    chunk_limit = chunks_per_thread;
 
-  cilk_for(unsigned int thread = 0; thread < num_threads; thread++) {
-    unsigned int chunk = 0;
-    unsigned chunk_limit; // It is possible that the last thread process less chunks
-    
-    if((thread == num_threads - 1) && (st->num_chunks%chunks_per_thread != 0))
-      chunk_limit = st->num_chunks%chunks_per_thread;
-    else
-      chunk_limit = chunks_per_thread;
-
-    //    printf("Chunk limit: %u\n", chunk_limit);
-    int16_t min = 0, max = 0, partial_excess = 0;
+  //    printf("Chunk limit: %u\n", chunk_limit);
+  pos_t min = 0, max = 0, partial_excess = 0;
+  
+  // Each thread traverses their chunks
+  for(chunk = 0; chunk < chunk_limit; chunk++) {
+    bit_index_t llimit = 0, ulimit = 0;
     
-    // Each thread traverses their chunks
-    for(chunk = 0; chunk < chunk_limit; chunk++) {
-      unsigned int llimit = 0, ulimit = 0;
-      
-      // Compute the limits of the current chunk
-      if(thread == (num_threads - 1) && chunk == (chunk_limit-1) && n % (st->num_chunks * st->s) != 0){
+    // Compute the limits of the current chunk
+    if(thread == (num_threads - 1) && chunk == (chunk_limit-1) && n % (st->num_chunks * st->s) != 0){
 	llimit = thread*chunks_per_thread*st->s+(st->s*chunk);
 	ulimit = n;
-      }
-      else {
+    }
+    else {
 	llimit = thread*chunks_per_thread*st->s + (st->s*chunk);
 	ulimit = llimit + st->s;
 	if(st->n < st->s)
 	  ulimit = n;
+    }
+    
+    bit_index_t symbol=0;
+    word_t w = 0;
+    pos_t chunk_base = partial_excess; // Excess value before the chunk
+
+    //      printf("llimit: %u, ulimit: %u",llimit, ulimit);
+
+    // The chunk starts at the beginning of a word, so it is scanned byte by
+    // byte, loading each word once. The maximum excess of a byte is the
+    // opposite of the minimum excess of its complement
+    for(symbol=llimit; symbol+8 <= ulimit; symbol+=8) {
+      if((symbol & (word_size-1)) == 0)
+	w = B->words[symbol>>logW];
+#ifdef LOOKUP16
+      if(!(symbol&15) && symbol+16 <= ulimit) {
+	word16_info x16 = T->word16[(uint16_t)w];
+	w >>= 16;
+	if(symbol==llimit || partial_excess + x16.min < min)
+	  min = partial_excess + x16.min;
+	if(symbol==llimit || partial_excess + x16.max > max)
+	  max = partial_excess + x16.max;
+	partial_excess += x16.sum;
+	symbol += 8;
+	continue;
       }
-      
-      unsigned int symbol=0;
-      
-      //      printf("llimit: %u, ulimit: %u",llimit, ulimit);
+#endif
+      uint8_t byte = w;
+      w >>= 8;
+
+      pos_t byte_min = partial_excess + T->min[byte];
+      pos_t byte_max = partial_excess - T->min[(uint8_t)~byte];
+      if(symbol==llimit || byte_min < min)
+	min = byte_min;
+      if(symbol==llimit || byte_max > max)
+	max = byte_max;
+      partial_excess += T->word_sum[byte];
+    }
 
-      for(symbol=llimit; symbol<ulimit; symbol++) {
+    for(; symbol<ulimit; symbol++) {
 	// Excess computation
 	if(bit_array_get_bit(B, symbol) == 0)
 	  --partial_excess;
@@ -174,43 +481,231 @@ rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n) {
 	  else if(partial_excess > max)
 	    max = partial_excess;	  
 	}
-      }
+    }
+
+    //      printf(", partial_excess: %d\n",partial_excess);
+
+    e_abs[thread*chunks_per_thread+chunk] = partial_excess;
+    leaf_min(st, thread*chunks_per_thread+chunk) = min - chunk_base;
+    leaf_max(st, thread*chunks_per_thread+chunk) = max - chunk_base;
+  }
+}
+
+// Final excess values of the chunks of the thread (step 2.2)
+static void emM_thread_excess(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  pos_t* e_abs = a->e_abs;
+  unsigned int num_threads = a->num_threads;
+  bit_index_t chunks_per_thread = a->chunks_per_thread;
+  unsigned int thread = i;
+
+  bit_index_t chunk = 0;
+  bit_index_t ul = chunks_per_thread;
+
+  if(thread == num_threads-1)
+    ul = st->num_chunks - (num_threads-1)*chunks_per_thread;
+  
+ /*
+   * Note 1: Thread 0 does not need to update their excess values
+   * Note 2: The minimum and maximum values of the leaves are relative to
+   * their chunks, so they do not need to be updated
+   */
+  for(chunk=0; chunk < ul; chunk++) {
+    if((thread == num_threads-1) || (chunk < chunks_per_thread -1))
+    	e_abs[thread*chunks_per_thread+chunk] += e_abs[(thread-1)*chunks_per_thread+chunks_per_thread-1];
+  }
+}
+
+#ifdef RMMT_BLOCKS
+// Excess value before the chunk c and bits of the chunk
+static void emM_block(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  BIT_ARRAY* B = a->B;
+  pos_t* e_abs = a->e_abs;
+  word_addr_t B_words = a->B_words;
+  bit_index_t c = i;
+
+  st->blocks[c].e = c ? e_abs[c-1] : 0;
+  word_addr_t w = c*RMMT_WORDS;
+  memcpy(st->blocks[c].bits, B->words + w,
+	   min((word_addr_t)RMMT_WORDS, B_words - w)*sizeof(word_t));
+}
+#else
+// Absolute excess sample i
+static void emM_sample(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  pos_t* e_abs = a->e_abs;
+
+  bit_index_t c = (i << E_SAMPLE_LOG) / st->s; // First chunk of the sample
+  st->e_sample[i] = c ? e_abs[c-1] : 0;
+}
+
+// Excess value of the leaf c relative to its sample
+static void emM_leaf(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  pos_t* e_abs = a->e_abs;
+  bit_index_t c = i;
 
-      //      printf(", partial_excess: %d\n",partial_excess);
+  st->leaves[c].e = e_abs[c] - st->e_sample[(c*RMMT_S) >> E_SAMPLE_LOG];
+}
+#endif
 
-      st->e_prime[thread*chunks_per_thread+chunk] = partial_excess;
-      st->m_prime[st->internal_nodes + thread*chunks_per_thread+chunk] = min;
-      st->M_prime[st->internal_nodes + thread*chunks_per_thread+chunk] = max;
+// Internal nodes of the subtree below level p_level (step 2.3)
+static void emM_subtree(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  int p_level = a->p_level;
+  unsigned int subtree = i;
+
+    for(int lvl = st->height-1; lvl >= p_level; lvl--){ //The current level that is being constructed.
+	//Note: The last level (leaves) is already constructed
+	bit_index_t num_curr_nodes = pow(st->k, lvl-p_level); //Number of nodes at curr_level level that belong to the subtree
+    
+    for(bit_index_t node = 0; node < num_curr_nodes; node++) {
+	bit_index_t pos = (pow(st->k,lvl)-1)/(st->k-1) + node + subtree*num_curr_nodes;// Position in the final array of 'node'.
+									    //Note: It should be less than the offset
+	bit_index_t lchild = pos*st->k+1, rchild = (pos+1)*st->k; //Range of children of 'node' in the final array
+	
+	// Nodes without leaves below get an empty range, so they never match
+	pos_t m = st->n, M = -(pos_t)st->n;
+	for(bit_index_t child = lchild; (child <= rchild) && (child < st->internal_nodes + st->num_chunks); child++) {
+	  m = min(m, node_min(st, child));
+	  M = max(M, node_max(st, child));
+	}
+	st->nodes[pos].m = m;
+	st->nodes[pos].M = M;
     }
   }
+}
+
+// Rank directory of the superblock sb (step 2.4)
+static void emM_rank_sblock(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  BIT_ARRAY* B = a->B;
+  bit_index_t num_blocks = a->num_blocks;
+  word_addr_t num_words = a->num_words;
+  bit_index_t sb = i;
+
+  bit_index_t ones = 0;
+  bit_index_t first = sb << (RANK_SB_LOG-RANK_B_LOG);
+  bit_index_t last = min(first + (1 << (RANK_SB_LOG-RANK_B_LOG)), num_blocks);
+
+  for(bit_index_t b = first; b < last; b++) {
+    st->rank_b[b] = ones;
+    word_addr_t w = b*RANK_B_WORDS;
+    word_addr_t w_last = min(w + RANK_B_WORDS, num_words);
+    for(; w < w_last; w++)
+	ones += popcount_word(B->words[w]);
+  }
+  st->rank_sb[sb] = ones;
+}
+
+// Select samples contained in the block b (step 2.5)
+static void emM_select_block(long i, void* arg) {
+  struct emM_args* a = arg;
+  rmMt* st = a->st;
+  unsigned long n = a->n;
+  bit_index_t num_blocks = a->num_blocks;
+  bit_index_t ones = a->ones;
+  bit_index_t b = i;
+
+  bit_index_t o_ll = block_rank(st, b); // Ones before the block
+  bit_index_t o_ul = (b+1 < num_blocks) ? block_rank(st, b+1) : ones;
+  bit_index_t z_ll = (b << RANK_B_LOG) - o_ll; // Zeros before the block
+  bit_index_t z_ul = min((b+1) << RANK_B_LOG, (bit_index_t)n) - o_ul;
+
+  // First sample with rank >= o_ll (z_ll)
+  bit_index_t k = (o_ll + (1 << SELECT_LOG) - 1) >> SELECT_LOG;
+  if((k << SELECT_LOG) < o_ul)
+    st->select1_s[k] = b;
+  k = (z_ll + (1 << SELECT_LOG) - 1) >> SELECT_LOG;
+  if((k << SELECT_LOG) < z_ul)
+    st->select0_s[k] = b;
+}
+
+rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n) {
+  rmMt* st = init_rmMt(n);
+
+  //print_rmMt(st);
+  
+  // num_chunks leaves (it does not need internal nodes)
+#ifdef RMMT_BLOCKS
+  st->blocks_mem = (rmM_block*)calloc(st->num_chunks + 1, sizeof(rmM_block));
+  st->blocks = (rmM_block*)(((uintptr_t)st->blocks_mem + CACHE_LINE-1) &
+			    ~(uintptr_t)(CACHE_LINE-1));
+#else
+  st->e_sample = (pos_t*)malloc((((n-1) >> E_SAMPLE_LOG) + 1)*sizeof(pos_t));
+  st->leaves = (mM_leaf*)calloc(st->num_chunks,sizeof(mM_leaf));
+#endif
+  // internal nodes. The node v is stored at position v+k-1 from a cache line
+  // boundary, so its children k*v+1..k*v+k start at position k*(v+1)
+  st->nodes_mem = (mM_node*)calloc(st->internal_nodes + CACHE_LINE/sizeof(mM_node) + RMMT_K,
+				   sizeof(mM_node));
+  uintptr_t line = ((uintptr_t)st->nodes_mem + CACHE_LINE-1) & ~(uintptr_t)(CACHE_LINE-1);
+  st->nodes = (mM_node*)line + RMMT_K - 1;
+
+  // Absolute excess value at the end of each chunk (only during construction)
+  pos_t* e_abs = (pos_t*)malloc(st->num_chunks*sizeof(pos_t));
+  st->B = B;
+  
+  if(st->s >= n){
+    fprintf(stderr, "Error: Input size is smaller or equal than the chunk size (input size: %lu, chunk size: %u)\n", n, st->s);
+    exit(0);
+  }
+  
+  /*
+   * STEP 1: The universal tables (also used to scan B during the
+   * construction) are constant data generated at build time
+   */
+
+  /*
+   * STEP 2: Computation of arrays e', m', M' and n'
+   */
+  unsigned int num_threads = threads;
+  // Each thread works on 'chunks_per_thread' consecutive chunks of B 
+  bit_index_t chunks_per_thread = ceil((double)st->num_chunks/num_threads);
+  // Threads without chunks are discarded (it happens when num_chunks is small)
+  num_threads = ceil((double)st->num_chunks/chunks_per_thread);
+  struct emM_args a = {.st = st, .B = B, .n = n, .e_abs = e_abs,
+		       .num_threads = num_threads,
+		       .chunks_per_thread = chunks_per_thread};
+
+  //  printf("Number of threads: %u\n", num_threads);
+  //  printf("Chunks per thread: %u\n", chunks_per_thread);
+  
+  /*
+   * STEP 2.1: Each thread computes the prefix computation in a range of the bit array
+   */
+
+  parallel_for(0, num_threads, emM_thread_chunks, &a);
 
   /*
    * STEP 2.2: Computation of the final prefix computations (desired values)
    */
   
   for(unsigned int thread=1; thread < num_threads-1; thread++) {
-    st->e_prime[thread*chunks_per_thread+chunks_per_thread-1] += st->e_prime[(thread-1)*chunks_per_thread+chunks_per_thread-1];
+    e_abs[thread*chunks_per_thread+chunks_per_thread-1] += e_abs[(thread-1)*chunks_per_thread+chunks_per_thread-1];
   }  
 
-  cilk_for(unsigned int thread=1; thread < num_threads; thread++) {
-    unsigned int chunk = 0;
-    unsigned int ul = chunks_per_thread;
+  parallel_for(1, num_threads, emM_thread_excess, &a);
 
-    if(thread == num_threads-1)
-      ul = st->num_chunks - (num_threads-1)*chunks_per_thread;
-    
-   /*
-     * Note 1: Thread 0 does not need to update their excess values
-     * Note 2:Thread 0 does not need to update the minimum value of its first chunk
-     */
-    for(chunk=0; chunk < ul; chunk++) {
-      if((thread == num_threads-1) || (chunk < chunks_per_thread -1))
-      	st->e_prime[thread*chunks_per_thread+chunk] += st->e_prime[(thread-1)*chunks_per_thread+chunks_per_thread-1];
-      st->m_prime[st->internal_nodes + thread*chunks_per_thread+chunk] += st->e_prime[(thread-1)*chunks_per_thread+chunks_per_thread-1];
-      st->M_prime[st->internal_nodes + thread*chunks_per_thread+chunk] += st->e_prime[(thread-1)*chunks_per_thread+chunks_per_thread-1];
-      
-    }
-  }
+#ifdef RMMT_BLOCKS
+  // Excess values before the chunks and bits of the chunks
+  a.B_words = ((n-1) >> logW) + 1;
+  parallel_for(0, st->num_chunks, emM_block, &a);
+#else
+  // Absolute samples and excess values of the leaves relative to them
+  parallel_for(0, ((n-1) >> E_SAMPLE_LOG) + 1, emM_sample, &a);
+
+  parallel_for(0, st->num_chunks, emM_leaf, &a);
+#endif
+
+  free(e_abs);
     
   /*
    * STEP 2.3: Completing the internal nodes of the min-max tree
@@ -218,353 +713,1269 @@ rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n) {
       
   int p_level = ceil(log(num_threads)/log(st->k)); /* p_level = logk(num_threads), level at which each thread has at least one 
 						  subtree to process in parallel */
+  if(p_level > (int)st->height)
+    p_level = st->height;
   unsigned int num_subtrees = pow(st->k,p_level); /* num_subtrees = k^p_level, number of subtrees of the min-max tree 
 						 that will be computed in parallel at level p_level.
 						 num_subtrees is O(num_threads) */
   
   //unsigned int subtree = 0;
   
-  cilk_for(unsigned int subtree = 0; subtree < num_subtrees; subtree++) {
-      for(int lvl = st->height-1; lvl >= p_level; lvl--){ //The current level that is being constructed.
-	//Note: The last level (leaves) is already constructed
-	unsigned int num_curr_nodes = pow(st->k, lvl-p_level); //Number of nodes at curr_level level that belong to the subtree
-      
-      for(unsigned int node = 0; node < num_curr_nodes; node++) {
-  	unsigned int pos = pow(st->k,lvl)-1 + node + subtree*num_curr_nodes;// Position in the final array of 'node'.
-  									    //Note: It should be less than the offset
-  	unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; //Range of children of 'node' in the final array
-	
-  	for(unsigned int child = lchild; (child <= rchild) && (child < st->num_chunks); child++) {
-  	  if(child == lchild){// first time
-  	    st->m_prime[pos] = st->m_prime[child];
-  	    st->M_prime[pos] = st->M_prime[child];
-  	  }
-  	  else {
-  	    if(st->m_prime[child] < st->m_prime[pos])
-  	      st->m_prime[pos] = st->m_prime[child];
-	    
-  	    if(st->M_prime[child] > st->M_prime[pos])
-  	      st->M_prime[pos] = st->M_prime[child];
-  	  }
-  	}
-      }
-    }
-  }
+  a.p_level = p_level;
+  parallel_for(0, num_subtrees, emM_subtree, &a);
    
   for(int lvl=p_level-1; lvl >= 0 ; lvl--){ // O(num_threads)
     
-    unsigned int num_curr_nodes = pow(st->k, lvl); // Number of nodes at curr_level level that belong to the subtree
-    unsigned int node = 0, child = 0;
+    bit_index_t num_curr_nodes = pow(st->k, lvl); // Number of nodes at curr_level level that belong to the subtree
+    bit_index_t node = 0, child = 0;
     
     for(node = 0; node < num_curr_nodes; node++) {
-      unsigned int pos = (pow(st->k,lvl)-1)/(st->k-1) + node; // Position in the final array of 'node'
-      unsigned int lchild = pos*st->k+1, rchild = (pos+1)*st->k; // Range of children of 'node' in the final array
-      for(child = lchild; (child <= rchild) && (child < st->num_chunks); child++){
-	if(child == lchild) { // first time
-	  st->m_prime[pos] = st->m_prime[child];
-	  st->M_prime[pos] = st->M_prime[child];
-	}
-	else {
-	  if(st->m_prime[child] < st->m_prime[pos])
-	    st->m_prime[pos] = st->m_prime[child];
-	  
-	  if(st->M_prime[child] > st->M_prime[pos])
-	    st->M_prime[pos] = st->M_prime[child];
-	}
+      bit_index_t pos = (pow(st->k,lvl)-1)/(st->k-1) + node; // Position in the final array of 'node'
+      bit_index_t lchild = pos*st->k+1, rchild = (pos+1)*st->k; // Range of children of 'node' in the final array
+      pos_t m = st->n, M = -(pos_t)st->n;
+      for(child = lchild; (child <= rchild) && (child < st->internal_nodes + st->num_chunks); child++){
+	m = min(m, node_min(st, child));
+	M = max(M, node_max(st, child));
       }
+      st->nodes[pos].m = m;
+      st->nodes[pos].M = M;
     }
   }
-  
+
+  /*
+   * STEP 2.4: Rank directory. Each superblock is processed in parallel and
+   * then the counts of the superblocks are accumulated
+   */
+
+  bit_index_t num_blocks = ((n-1) >> RANK_B_LOG) + 1;
+  bit_index_t num_sblocks = ((n-1) >> RANK_SB_LOG) + 1;
+  st->rank_b = (uint16_t*)malloc(num_blocks*sizeof(uint16_t));
+  st->rank_sb = (bit_index_t*)malloc(num_sblocks*sizeof(bit_index_t));
+  a.num_blocks = num_blocks;
+  a.num_words = ((n-1) >> logW) + 1;
+
+  parallel_for(0, num_sblocks, emM_rank_sblock, &a);
+
+  bit_index_t ones = 0;
+  for(bit_index_t sb = 0; sb < num_sblocks; sb++) {
+    bit_index_t c = st->rank_sb[sb];
+    st->rank_sb[sb] = ones;
+    ones += c;
+  }
+  st->ones = ones;
+  a.ones = ones;
+
   /*
-   * STEP 3: Computation of all universal tables
+   * STEP 2.5: Select samples. Each block stores the sample that it contains
    */
 
-  T = create_lookup_tables();
+  bit_index_t zeros = n - ones;
+  st->select1_s = (bit_index_t*)malloc((((ones-1) >> SELECT_LOG) + 1)*sizeof(bit_index_t));
+  st->select0_s = (bit_index_t*)malloc((((zeros-1) >> SELECT_LOG) + 1)*sizeof(bit_index_t));
+
+  parallel_for(0, num_blocks, emM_select_block, &a);
+
+#ifdef RMMT_BLOCKS
+  // The blocks keep a copy of the bits
+  bit_array_free(B);
+  st->B = NULL;
+#endif
 
   return st;
 }
 
-int32_t sum(rmMt* st, int32_t idx){
-
-  if(idx >= st->n)
-    return -1;
-  
-  int32_t chk = idx/st->s;
-  int32_t excess = 0;
+// Number of ones in B[0,i]
+#ifdef RMMT_BLOCKS
+// The ones before the block of i follow from the excess value before it
+static inline bit_index_t rank_ones(rmMt* st, bit_index_t i) {
+  bit_index_t c = i / RMMT_S;
+  rmM_block* block = &st->blocks[c];
+  bit_index_t r = (c*RMMT_S + block->e)/2;
 
-  // Previous chunk
-  if(chk)
-    excess += st->e_prime[chk-1];
-  
-  int llimit = chk*st->s;
-  int rlimit = (idx/8)*8;
+  word_addr_t last = (i - c*RMMT_S) >> logW;
+  for(word_addr_t w = 0; w < last; w++)
+    r += popcount_word(block->bits[w]);
 
-  word_t j=0;
-  for(j=llimit; j<rlimit; j+=8) {
-#ifdef ARCH64
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
+  return r + popcount_word(block->bits[last] &
+			   (~(word_t)0 >> (word_size-1-(i&(word_size-1)))));
+}
 #else
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
+static inline bit_index_t rank_ones(rmMt* st, bit_index_t i) {
+  bit_index_t r = st->rank_sb[i >> RANK_SB_LOG] + st->rank_b[i >> RANK_B_LOG];
+
+  word_addr_t w = (i >> RANK_B_LOG)*RANK_B_WORDS;
+  word_addr_t last = i >> logW;
+  for(; w < last; w++)
+    r += popcount_word(st_word(st, w));
+
+  return r + popcount_word(st_word(st, last) &
+			   (~(word_t)0 >> (word_size-1-(i&(word_size-1)))));
+}
 #endif
 
-    excess += T->word_sum[sum_idx];
-  }
+pos_t sum(rmMt* st, pos_t idx){
 
-  for(uint i=j; i<=idx; i++)
-    excess += 2*bit_array_get_bit(st->B,i)-1;
+  if(idx < 0 || idx >= (pos_t)st->n)
+    return -1;
 
-  return excess;
+  return 2*(pos_t)rank_ones(st, idx) - (idx+1);
 }
 
-int32_t check_leaf(rmMt* st, int32_t i, int32_t d) {
-  int end = (i/st->s+1)*st->s;
-  int llimit = (((i)+8)/8)*8;
-  int rlimit = (end/8)*8;
-  int32_t excess = d;
-  int32_t output;
-  int32_t j = 0;
-
-  //  printf("i: %u, end: %u, llimit: %u, rlimit: %u\n", i, end, llimit, rlimit);
-  
-  //  printf("d: %u\n",  d);
-  for(j=i+1; j< min(end, llimit); j++){
-    excess += 2*bit_array_get_bit(st->B,j)-1;
-    //        printf("excess: %u\n",  excess);
-    if(excess == d-1)
-      return j;
-  }
+/*
+ * In-chunk scans. The bits are processed one by one up to a byte boundary and
+ * then byte by byte with the tables near_fwd_pos/near_bwd_pos, which give the
+ * first (last) position of a byte where a relative excess in [-8,8] is reached.
+ * find_close, find_open and enclose only search for lower excess values, so
+ * they use min_match_pos_packed/max_match_pos_packed instead (1 KB each, with
+ * the positions for the excess values [-8,-1] of a byte in one word)
+ */
 
-  for(j=llimit; j<rlimit; j+=8) {
-    int32_t desired = d - 1 - excess; // desired value must belongs to the range [-8,8]
-    //    printf("d: %d, desired: %u, current: %u\n", d, desired, excess);
-    
-#ifdef ARCH64
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
+// Words of B from the word w. The words of a chunk are consecutive
+static inline const word_t* st_words(rmMt* st, word_addr_t w) {
+#ifdef RMMT_BLOCKS
+  return &st->blocks[w / RMMT_WORDS].bits[w % RMMT_WORDS];
 #else
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
+  return &st->B->words[w];
 #endif
-    
-    if (desired >= -8 && desired <= 8) {
-    uint16_t ii = (desired+8<<8) + sum_idx;
-        
-    int8_t x = T->near_fwd_pos[ii];
-    //    printf("sum_idx: %u, ii: %d, x: %d\n", sum_idx, ii, x);
+}
+
+// First position of the byte that starts at j with excess value d, where e is
+// the excess value before the byte. It returns -1 if there is no such position
+// and adds the excess of the byte to e otherwise
+static inline pos_t fwd_byte(uint8_t byte, pos_t j, pos_t* e, pos_t d) {
+  pos_t desired = d - *e;
+  if(desired < 0 && desired >= -8) {
+    uint8_t x = (T->min_match_pos_packed[byte] >> 4*(-desired-1)) & 0xF;
     if(x < 8)
       return j+x;
   }
-    //excess -= T->word_sum[((*((st->B)->words+(j>>5)))>>(j&0xFF))&0xFF ];
-    excess += T->word_sum[sum_idx];
-  }
-  
-  for (j=max(llimit,rlimit); j < end; ++j) {
-    excess += 2*bit_array_get_bit(st->B,j)-1;
-    if (excess == d-1) {
-      return j;
-    }
+  else if(desired >= 0 && desired <= 8) {
+    uint8_t x = T->near_fwd_pos[((desired+8)<<8) | byte];
+    if(x < 8)
+      return j+x;
   }
-  
-  return i-1;
+  *e += T->word_sum[byte];
+  return -1;
 }
 
+// Last position in [q-1,q+7] with excess value d, where e is the excess value
+// at q+7. It returns -2 if there is no such position and subtracts the excess of
+// the byte that starts at q from e otherwise
+static inline pos_t bwd_byte(uint8_t byte, pos_t q, pos_t* e, pos_t d) {
+  if(*e == d)
+    return q+7;
 
-int32_t check_sibling(rmMt* st, int32_t i, int32_t d) {
-  int llimit = i;
-  int rlimit = i+st->s;
-  int32_t output;
-  int32_t excess = st->e_prime[(i-1)/st->s];
-  int32_t j = 0;
-
-  //  printf("i: %u, llimit: %u, rlimit: %u\n", i, llimit, rlimit);
-   
-  for(j=llimit; j<rlimit; j+=8) {
-    int32_t desired = d - 1 - excess; // desired value must belongs to the range [-8,8]  
-    //    printf("d: %d, desired: %u, current: %u\n", d, desired, excess);
-    
-#ifdef ARCH64
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
-#else
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
-#endif
-    
-    if (desired >= -8 && desired <= 8) {
-    uint16_t ii = (desired+8<<8) + sum_idx;
-    
-    int8_t x = T->near_fwd_pos[ii];
-    //    printf("sum_idx: %u, ii: %d, x: %d\n", sum_idx, ii, x);
+  // The table gives the last position p of the byte such that the excess
+  // just before p is d
+  pos_t desired = d - *e;
+  if(desired < 0 && desired >= -8) {
+    uint8_t x = (T->max_match_pos_packed[byte] >> 4*(-desired-1)) & 0xF;
     if(x < 8)
-      return j+x;
+      return q+x-1;
   }
-    excess += T->word_sum[sum_idx];
+  else if(desired >= 0 && desired <= 8) {
+    uint8_t x = T->near_bwd_pos[((desired+8)<<8) | byte];
+    if(x < 8)
+      return q+x-1;
   }
-    
-  return i-1;
+  *e -= T->word_sum[byte];
+  return -2;
 }
 
-int32_t fwd_search(rmMt* st, int32_t i) {
-    // Excess value up to the ith position 
-    int32_t d = sum(st, i);
-    
-    int chunk = i / st->s;
-    int32_t output;
-    long j;
-    
-    // Case 1: Check if the chunk of i contains fwd_search(B, i, d)
-    
-    output = check_leaf(st, i, d);
-    if(output > i)
-      return output;
-    
-    // Case 2: The answer is not in the chunk of i, but it is in its sibling
-    // (assuming a binary tree, if i%2==0, then its right sibling is at position
-    // i+1)
-    
-    if(chunk%2 == 0) { // The current chunk has a right sibling
-      // The answer is in the right sibling of the current node
-      if(st->m_prime[chunk+1] <= d && d <= st->M_prime[chunk+1]) { 
-	output = check_sibling(st, st->s*(chunk+1), d);
-	if(output >= st->s*(chunk+1))
-	  return output;
-      }
+#define st_byte(st, j) ((uint8_t)(st_word(st, (j)>>logW) >> ((j)&(word_size-1))))
+
+// First position j in [i,end) with excess(j) = d, where e = excess(i-1). It
+// returns -1 if there is no such position
+static pos_t fwd_scan(rmMt* st, pos_t i, pos_t end, pos_t e, pos_t d) {
+  pos_t j = i, x;
+
+  for(; j < end && (j&7); j++) {
+    e += 2*st_get_bit(st, j)-1;
+    if(e == d)
+      return j;
+  }
+
+  // Bytes up to a group of 32 bits and whole groups
+  if(fwd_groups != NULL && j+32 <= end) {
+    for(; j&31; j+=8)
+      if((x = fwd_byte(st_byte(st, j), j, &e, d)) >= 0)
+	return x;
+    pos_t num = (end-j) >> 5;
+    if((x = fwd_groups(st_words(st, j>>logW), j, num, &e, d)) >= 0)
+      return x;
+    j += num << 5;
+  }
+
+  word_t w = 0;
+  pos_t llimit = j;
+  for(; j+8 <= end; j+=8) {
+    if(j == llimit || (j&(word_size-1)) == 0) // Load each word once
+      w = st_word(st, j>>logW) >> (j&(word_size-1));
+#ifdef LOOKUP16
+    // Skip 16 parentheses whose excess values do not reach d
+    if(!(j&15) && j+16 <= end) {
+      word16_info x16 = T->word16[(uint16_t)w];
+      if(d-e < x16.min || d-e > x16.max) {
+	e += x16.sum;
+	w >>= 16;
+	j += 8;
+	continue;
+      }
     }
-  
-    // Case 3: It is necessary up and then down in the min-max tree
-    
-    long node = parent(st->internal_nodes + chunk); // Initial node
-    // Go up the tree
-    while (!is_root(node)) {
-      //      printf("[Up] node: %ld\n", node);
-      if (is_left_child(node)) { // if the node is a left child
-	node = right_sibling(node); // choose right sibling
-	
-	if (st->m_prime[node] <= d-1 && d-1 <= st->M_prime[node])
-	  break;
+#endif
+    if((x = fwd_byte(w, j, &e, d)) >= 0)
+      return x;
+    w >>= 8;
+  }
+
+  for(; j < end; j++) {
+    e += 2*st_get_bit(st, j)-1;
+    if(e == d)
+      return j;
+  }
+
+  return -1;
+}
+
+// Last position j in [start-1,i] with excess(j) = d, where e = excess(i). The
+// position start-1 is only reported when it is the last one of a byte. It
+// returns -2 if there is no such position
+static pos_t bwd_scan(rmMt* st, pos_t i, pos_t start, pos_t e, pos_t d) {
+  pos_t j = i, x;
+
+  for(; j >= start && ((j+1)&7); j--) {
+    if(e == d)
+      return j;
+    e -= 2*st_get_bit(st, j)-1;
+  }
+
+  // j is the last position of a byte. Bytes down to a group of 32 bits and
+  // whole groups
+  if(bwd_groups != NULL && j-31 >= start) {
+    for(; (j+1)&31; j-=8)
+      if((x = bwd_byte(st_byte(st, j-7), j-7, &e, d)) > -2)
+	return x;
+    pos_t num = (j+1-start) >> 5;
+    if((x = bwd_groups(st_words(st, j>>logW), j, num, &e, d)) > -2)
+      return x;
+    j -= num << 5;
+  }
+
+  for(; j-7 >= start; j-=8) {
+#ifdef LOOKUP16
+    // Skip 16 parentheses (and the position before them) whose excess values
+    // do not reach d
+    if(!((j+1)&15) && j-15 >= start) {
+      word16_info x16 = T->word16[(uint16_t)(st_word(st, (j-15)>>logW) >>
+					     ((j-15)&(word_size-1)))];
+      pos_t desired = d - (e - x16.sum);
+      if(desired < min(x16.min, 0) || desired > max(x16.max, 0)) {
+	e -= x16.sum;
+	j -= 8;
+	continue;
       }
+    }
+#endif
+    if((x = bwd_byte(st_byte(st, j-7), j-7, &e, d)) > -2)
+      return x;
+  }
+
+  for(; j >= start; j--) {
+    if(e == d)
+      return j;
+    e -= 2*st_get_bit(st, j)-1;
+  }
+
+  return -2;
+}
+
+// Valid node of the min-max tree whose range of excess values contains d
+static inline int node_contains(rmMt* st, long node, pos_t d) {
+  return node < (long)(st->internal_nodes + st->num_chunks) &&
+    node_min(st, node) <= d && d <= node_max(st, node);
+}
+
+// fwd_search when the excess value up to the ith position, e, is known
+static pos_t fwd_search_e(rmMt* st, pos_t i, pos_t e, pos_t d) {
+  d += e; // Desired excess value
+    
+  bit_index_t chunk = i / RMMT_S;
+  pos_t output;
+    
+  // Case 1: Check if the chunk of i contains fwd_search(B, i, d)
+    
+  output = fwd_scan(st, i+1, min((chunk+1)*RMMT_S, st->n), e, d);
+  if(output >= 0)
+    return output;
+    
+  // Case 2: Go up the min-max tree until a right sibling contains d (it
+  // includes the siblings of the chunk of i)
+
+  long node = st->internal_nodes + chunk; // Initial node
+  int found = 0;
+  while (!found && !is_root(node)) {
+    long last = last_sibling(node);
+    while (!found && node < last)
+      found = node_contains(st, ++node, d);
+    if (!found)
       node = parent(node); // choose parent
+  }
+
+  if (!found)
+    return -1;
+
+  // Go down the tree, choosing the leftmost child that contains d
+  while (!is_leaf(node, st)) {
+    node = first_child(node);
+    while (!node_contains(st, node, d))
+      node++;
+  }
+
+  chunk = node - st->internal_nodes;
+  return fwd_scan(st, chunk*RMMT_S, min((chunk+1)*RMMT_S, st->n),
+		  excess_before(st, chunk), d);
+}
+
+pos_t fwd_search(rmMt* st, pos_t i, pos_t d) {
+  // Excess value up to the ith position
+  return fwd_search_e(st, i, sum(st, i), d);
+}
+
+pos_t bwd_search(rmMt* st, pos_t i, pos_t d) {
+  // Excess value up to the ith position
+  pos_t e = sum(st, i);
+  d += e; // Desired excess value
+
+  bit_index_t chunk = i / RMMT_S;
+  pos_t output;
+
+  // Case 1: Check if the chunk of i contains bwd_search(B, i, d)
+
+  e -= 2*st_get_bit(st, i)-1; // Excess value up to position i-1
+  output = bwd_scan(st, i-1, chunk*RMMT_S, e, d);
+  if(output > -2)
+    return output;
+
+  // Case 2: Go up the min-max tree until a left sibling contains d
+
+  long node = st->internal_nodes + chunk; // Initial node
+  int found = 0;
+  while (!found && !is_root(node)) {
+    long first = first_sibling(node);
+    while (!found && node > first)
+      found = node_contains(st, --node, d);
+    if (!found)
+      node = parent(node); // choose parent
+  }
+
+  // The position -1 (before the sequence) has excess value 0
+  if (!found)
+    return (d == 0) ? -1 : -2;
+
+  // Go down the tree, choosing the rightmost child that contains d
+  while (!is_leaf(node, st)) {
+    node = last_child(node);
+    while (!node_contains(st, node, d))
+      node--;
+  }
+
+  chunk = node - st->internal_nodes;
+  return bwd_scan(st, min((chunk+1)*RMMT_S, st->n)-1, chunk*RMMT_S,
+		  chunk_excess(st, chunk), d);
+}
+
+/*
+ * Pioneers (Jacobson; Geary, Raman and Raman). The far parentheses of a chunk
+ * are nested, so their matches appear in decreasing order and the ones between
+ * two consecutive pioneers have their matches in the chunk of the match of the
+ * first one. Given the pioneer that precedes a far parenthesis i with excess
+ * value e, the match of i is the first position of that chunk with excess
+ * value e-1, found with one scan since the pioneer keeps the excess value
+ * before that chunk. A chunk has few pioneers (O(n/s) in total), so the search
+ * among them is constant in practice
+ */
+
+// Last chunk after b whose leaf is checked directly by find_close: the last
+// sibling of the leaf of b, or the next chunk if b is the last sibling
+static inline bit_index_t near_chunk(rmMt* st, bit_index_t b) {
+  long last = last_sibling(st->internal_nodes + b) - st->internal_nodes;
+  return min(max(last, (long)b+1), (long)st->num_chunks-1);
+}
+
+// The far parentheses of the chunk b and the chunks of their matches, from
+// right to left. It returns their number
+static unsigned int far_parentheses(rmMt* st, bit_index_t b, uint16_t* off,
+				    bit_index_t* match_chunk) {
+  pos_t start = b*RMMT_S, end = min((b+1)*RMMT_S, st->n) - 1;
+  pos_t e_end = chunk_excess(st, b), e = e_end;
+  pos_t m = e_end; // Minimum excess value in (j,end]
+  bit_index_t c = st->num_chunks;
+  unsigned int num = 0;
+
+  for(pos_t j = end; j >= start; j--) {
+    int bit = st_get_bit(st, j);
+    if(bit && m >= e) {
+      // The matches of the far parentheses move to the right, so the chunk of
+      // the previous match is kept while it reaches the excess value e-1
+      if(num == 0 || (c < st->num_chunks &&
+		      node_min(st, st->internal_nodes + c) > e-1)) {
+	pos_t r = fwd_search_e(st, end, e_end, e-1 - e_end);
+	c = (r < 0) ? st->num_chunks : (bit_index_t)(r / RMMT_S);
+      }
+      off[num] = j - start;
+      match_chunk[num++] = c;
     }
+    m = min(m, e);
+    e -= 2*bit - 1;
+  }
 
-    //    printf("[Choosen] node: %ld\n", node);
-  
-    // Go down the tree
-    if (!is_root(node)) { // found solution for the query
-      //      printf("The node is not the root\n");
-      while (!is_leaf(node, st)) {
-	//	printf("[Down] node: %ld\n", node);
-	node = left_child(node); // choose left child
-	if (!(st->m_prime[node] <= d-1 && d-1 <= st->M_prime[node])) {
-	  node = right_sibling(node); // choose right child == right sibling of the left child
-	  if(st->m_prime[node] > d-1 || d-1 > st->M_prime[node]) {
-	    return -1;
+  return num;
+}
+
+// Data shared by the parallel loops of st_build_pioneers
+struct pioneers_args {
+  rmMt* st;
+  bit_index_t chunks_per_part;
+  bit_index_t* first;
+  pioneer** part_p;
+  bit_index_t* part_len;
+};
+
+// Pioneers of the chunks of the part
+static void pioneers_collect(long i, void* arg) {
+  struct pioneers_args* a = arg;
+  rmMt* st = a->st;
+  bit_index_t chunks_per_part = a->chunks_per_part;
+  bit_index_t* first = a->first;
+  pioneer** part_p = a->part_p;
+  bit_index_t* part_len = a->part_len;
+  bit_index_t part = i;
+
+  bit_index_t lo = part*chunks_per_part;
+  bit_index_t hi = min(lo + chunks_per_part, st->num_chunks);
+  bit_index_t len = 0, cap = hi-lo + RMMT_S;
+  pioneer* p = (pioneer*)malloc(cap*sizeof(pioneer));
+  uint16_t* far_off = (uint16_t*)malloc(RMMT_S*sizeof(uint16_t));
+  bit_index_t* far_chunk = (bit_index_t*)malloc(RMMT_S*sizeof(bit_index_t));
+
+  for(bit_index_t b = lo; b < hi; b++) {
+    first[b] = len;
+    unsigned int num = far_parentheses(st, b, far_off, far_chunk);
+    if(len + num > cap) {
+      cap = 2*cap + num;
+      p = (pioneer*)realloc(p, cap*sizeof(pioneer));
+    }
+    // From left to right, the first far parenthesis of each match chunk.
+    // The matches up to near_chunk(b) are found without pioneers and they
+    // belong to the last far parentheses, so those pioneers are dropped
+    bit_index_t near = near_chunk(st, b);
+    for(unsigned int k = num; k-- > 0; )
+      if((k == num-1 || far_chunk[k] != far_chunk[k+1]) &&
+	 far_chunk[k] > near) {
+	bit_index_t c = far_chunk[k];
+	p[len++] = (pioneer){far_off[k], c,
+			     (c < st->num_chunks) ? excess_before(st, c) : 0};
+      }
+  }
+
+  part_p[part] = p;
+  part_len[part+1] = len;
+  free(far_off);
+  free(far_chunk);
+}
+
+// Copy of the pioneers of the part into the final array
+static void pioneers_copy(long i, void* arg) {
+  struct pioneers_args* a = arg;
+  rmMt* st = a->st;
+  bit_index_t chunks_per_part = a->chunks_per_part;
+  bit_index_t* first = a->first;
+  pioneer** part_p = a->part_p;
+  bit_index_t* part_len = a->part_len;
+  bit_index_t part = i;
+
+  bit_index_t lo = part*chunks_per_part;
+  bit_index_t hi = min(lo + chunks_per_part, st->num_chunks);
+  bit_index_t base = part_len[part], len = part_len[part+1] - base;
+  for(bit_index_t b = lo; b < hi; b++)
+    first[b] += base;
+  memcpy(st->pioneers + base, part_p[part], len*sizeof(pioneer));
+  free(part_p[part]);
+}
+
+// Directory of the superblock sb
+static void pioneers_directory(long i, void* arg) {
+  struct pioneers_args* a = arg;
+  rmMt* st = a->st;
+  bit_index_t* first = a->first;
+  bit_index_t sb = i;
+
+  bit_index_t lo = sb*PIONEER_SB_CHUNKS;
+  bit_index_t hi = min(lo + PIONEER_SB_CHUNKS, st->num_chunks+1);
+  st->pioneer_sb[sb] = first[lo];
+  for(bit_index_t c = lo; c < hi; c++)
+    st->pioneer_first[c] = first[c] - first[lo];
+}
+
+void st_build_pioneers(rmMt* st) {
+  if(st->pioneer_first != NULL)
+    return;
+
+  // Each part of the chunks collects its pioneers in its own arrays
+  bit_index_t num_parts = min((bit_index_t)threads, st->num_chunks);
+  bit_index_t chunks_per_part = (st->num_chunks + num_parts - 1)/num_parts;
+  num_parts = (st->num_chunks + chunks_per_part - 1)/chunks_per_part;
+
+  // Number of pioneers before each chunk (relative to its part, and then
+  // absolute)
+  bit_index_t* first = (bit_index_t*)malloc((st->num_chunks+1)*sizeof(bit_index_t));
+  pioneer** part_p = (pioneer**)malloc(num_parts*sizeof(pioneer*));
+  bit_index_t* part_len = (bit_index_t*)calloc(num_parts+1, sizeof(bit_index_t));
+  struct pioneers_args a = {st, chunks_per_part, first, part_p, part_len};
+
+  parallel_for(0, num_parts, pioneers_collect, &a);
+
+  for(bit_index_t part = 0; part < num_parts; part++)
+    part_len[part+1] += part_len[part];
+
+  bit_index_t total = part_len[num_parts];
+  st->pioneers = (pioneer*)malloc((total+1)*sizeof(pioneer));
+  first[st->num_chunks] = total;
+
+  parallel_for(0, num_parts, pioneers_copy, &a);
+
+  // Two-level directory of the first pioneer of each chunk
+  bit_index_t num_sb = st->num_chunks/PIONEER_SB_CHUNKS + 1;
+  st->pioneer_sb = (bit_index_t*)malloc(num_sb*sizeof(bit_index_t));
+  st->pioneer_first = (uint16_t*)malloc((st->num_chunks+1)*sizeof(uint16_t));
+  parallel_for(0, num_sb, pioneers_directory, &a);
+
+  free(first);
+  free(part_p);
+  free(part_len);
+}
+
+// Entry of the first pioneer of the chunk c
+static inline bit_index_t first_pioneer(rmMt* st, bit_index_t c) {
+  return st->pioneer_sb[c/PIONEER_SB_CHUNKS] + st->pioneer_first[c];
+}
+
+// Chunk of the match of the opening parenthesis i, where e is the excess value
+// up to the ith position, when the match is not in the chunk of i. *before is
+// the excess value before that chunk. It returns num_chunks if i has no match
+static bit_index_t far_match(rmMt* st, pos_t i, pos_t e, pos_t* before) {
+  // As in fwd_search, the leaves of the next chunks (the right siblings of the
+  // leaf of i, or at least the next leaf) are checked first
+  bit_index_t chunk = i / RMMT_S;
+  if(chunk+1 == st->num_chunks)
+    return st->num_chunks;
+  bit_index_t near = near_chunk(st, chunk);
+  for(bit_index_t c = chunk+1; c <= near; c++)
+    if(node_min(st, st->internal_nodes + c) <= e-1) {
+      *before = excess_before(st, c);
+      return c;
+    }
+
+  // Otherwise the chunk has a pioneer at or before i with a farther match
+  bit_index_t lo = first_pioneer(st, chunk), hi = first_pioneer(st, chunk+1)-1;
+  uint16_t off = i - chunk*RMMT_S;
+  while(lo < hi) {
+    bit_index_t mid = lo + (hi-lo+1)/2;
+    if(st->pioneers[mid].off <= off)
+      lo = mid;
+    else
+      hi = mid-1;
+  }
+
+  *before = st->pioneers[lo].e;
+  return st->pioneers[lo].chunk;
+}
+
+// find_close of the opening parenthesis i, where e is the excess value up to
+// the ith position
+static pos_t find_close_e(rmMt* st, pos_t i, pos_t e) {
+  if(st->pioneer_first == NULL)
+    return fwd_search_e(st, i, e, -1);
+
+  bit_index_t chunk = i / RMMT_S;
+  pos_t output = fwd_scan(st, i+1, min((chunk+1)*RMMT_S, st->n), e, e-1);
+  if(output >= 0)
+    return output;
+
+  pos_t before;
+  chunk = far_match(st, i, e, &before);
+  if(chunk == st->num_chunks)
+    return -1;
+
+  return fwd_scan(st, chunk*RMMT_S, min((chunk+1)*RMMT_S, st->n), before,
+		  e-1);
+}
+
+pos_t find_close(rmMt* st, pos_t i){
+  if(st_get_bit(st, i) == 0)
+    return -1;
+
+  return find_close_e(st, i, sum(st, i));
+}
+
+pos_t find_open(rmMt* st, pos_t i){
+  if(st_get_bit(st, i) == 1)
+    return -1;
+
+  return bwd_search(st, i, 0) + 1;
+}
+
+pos_t enclose(rmMt* st, pos_t i){
+  if(st_get_bit(st, i) == 0)
+    i = find_open(st, i);
+
+  return bwd_search(st, i, -2) + 1;
+}
+
+/*
+ * Range minimum queries. The ends of the range are scanned byte by byte with
+ * T->min and T->min_pos_max, and the chunks in between are covered by O(log n)
+ * nodes of the min-max tree. The rightmost minimum is kept, so the node with
+ * the minimum is descended through its rightmost child that reaches it
+ */
+
+// Minimum excess value in [i,j], where e = excess(i-1). If it is less than or
+// equal to *min, *min and *pos (its rightmost position) are updated
+static void min_scan(rmMt* st, pos_t i, pos_t j, pos_t e, pos_t* min,
+		     pos_t* pos) {
+  pos_t k = i;
+
+  for(; k <= j && (k&7); k++) {
+    e += 2*st_get_bit(st, k)-1;
+    if(e <= *min) {
+      *min = e;
+      *pos = k;
+    }
+  }
+
+  word_t w = 0;
+  pos_t llimit = k;
+  for(; k+7 <= j; k+=8) {
+    if(k == llimit || (k&(word_size-1)) == 0) // Load each word once
+      w = st_word(st, k>>logW) >> (k&(word_size-1));
+#ifdef LOOKUP16
+    if(!(k&15) && k+15 <= j) {
+      word16_info x16 = T->word16[(uint16_t)w];
+      w >>= 16;
+      if(e + x16.min <= *min) {
+	*min = e + x16.min;
+	*pos = k + x16.min_pos_max;
+      }
+      e += x16.sum;
+      k += 8;
+      continue;
+    }
+#endif
+    uint8_t byte = w;
+    w >>= 8;
+
+    if(e + T->min[byte] <= *min) {
+      *min = e + T->min[byte];
+      *pos = k + T->min_pos_max[byte];
+    }
+    e += T->word_sum[byte];
+  }
+
+  for(; k <= j; k++) {
+    e += 2*st_get_bit(st, k)-1;
+    if(e <= *min) {
+      *min = e;
+      *pos = k;
+    }
+  }
+}
+
+// Rightmost position of the minimum excess value in [i,j], stored in *min
+static pos_t range_min(rmMt* st, pos_t i, pos_t j, pos_t* min) {
+  bit_index_t ci = i / RMMT_S, cj = j / RMMT_S;
+  pos_t e = (i > 0) ? sum(st, i-1) : 0;
+  pos_t pos = i;
+
+  *min = e + 2; // Larger than the excess value at position i
+  if(ci == cj) {
+    min_scan(st, i, j, e, min, &pos);
+    return pos;
+  }
+
+  min_scan(st, i, (ci+1)*RMMT_S - 1, e, min, &pos);
+
+  // Chunks ci+1..cj-1, as runs of siblings of the min-max tree in left to
+  // right order. The runs on the right side are visited after going up
+  if(ci+1 < cj) {
+    long l = st->internal_nodes + ci + 1, r = st->internal_nodes + cj - 1;
+    long right_l[64], right_r[64]; // At most one run per level
+    int num_right = 0;
+    long best = -1;
+
+    while(l <= r) {
+      if(parent(l) == parent(r)) {
+	for(long node = l; node <= r; node++)
+	  if(node_min(st, node) <= *min) {
+	    *min = node_min(st, node);
+	    best = node;
 	  }
-	}
+	break;
       }
+      if(l != first_sibling(l)) {
+	long last = last_sibling(l);
+	for(; l <= last; l++)
+	  if(node_min(st, l) <= *min) {
+	    *min = node_min(st, l);
+	    best = l;
+	  }
+      }
+      if(r != last_sibling(r)) {
+	right_l[num_right] = first_sibling(r);
+	right_r[num_right++] = r;
+	r = first_sibling(r) - 1;
+      }
+      l = parent(l);
+      r = parent(r);
+    }
+    while(num_right > 0) {
+      num_right--;
+      for(long node = right_l[num_right]; node <= right_r[num_right]; node++)
+	if(node_min(st, node) <= *min) {
+	  *min = node_min(st, node);
+	  best = node;
+	}
+    }
 
-      //      printf("[Choosen] node: %ld\n", node);
-      chunk = node - st->internal_nodes;
-      //      printf("Chunk(leaf): %d\n", chunk);
-      return check_sibling(st, st->s*chunk, d);
-      //      return leaves_check(B, s*chunk, excess);
+    // Go down to the rightmost chunk that reaches the minimum
+    if(best >= 0) {
+      while(!is_leaf(best, st)) {
+	long child = last_child(best);
+	while(!node_contains(st, child, *min) || node_min(st, child) != *min)
+	  child--;
+	best = child;
+      }
+      bit_index_t chunk = best - st->internal_nodes;
+      pos_t m = *min + 1; // The scan must reach the minimum again
+      min_scan(st, chunk*RMMT_S, (chunk+1)*RMMT_S - 1, excess_before(st, chunk),
+	       &m, &pos);
     }
+  }
+
+  min_scan(st, cj*RMMT_S, j, excess_before(st, cj), min, &pos);
+
+  return pos;
+}
+
+pos_t rmq(rmMt* st, pos_t i, pos_t j) {
+  pos_t min;
+
+  range_min(st, i, j, &min);
+  return min;
+}
+
+pos_t rmqi(rmMt* st, pos_t i, pos_t j) {
+  pos_t min;
+
+  return range_min(st, i, j, &min);
+}
+
+pos_t lca(rmMt* st, pos_t i, pos_t j) {
+  if(i > j) {
+    pos_t tmp = i;
+    i = j;
+    j = tmp;
+  }
+
+  if(j <= find_close(st, i)) // i is an ancestor of j
+    return i;
+
+  return enclose(st, rmqi(st, i, j) + 1);
+}
+
+pos_t subtree_size(rmMt* st, pos_t i) {
+  return (find_close(st, i) - i + 1) / 2;
+}
+
+pos_t depth(rmMt* st, pos_t i) {
+  return sum(st, i);
+}
+
+pos_t level_ancestor(rmMt* st, pos_t i, pos_t d) {
+  if(d < 0)
     return -1;
+
+  return bwd_search(st, i, -d-1) + 1;
+}
+
+pos_t level_next(rmMt* st, pos_t i) {
+  return fwd_search(st, find_close(st, i), 1);
 }
 
-/* TODO: Test this function*/
-int32_t find_close(rmMt* st, int32_t i){
-  if(bit_array_get_bit(st->B,i) == 0)
+pos_t level_prev(rmMt* st, pos_t i) {
+  // The last position j < i with the excess value of i is followed by the
+  // closing parenthesis of the previous node with the same depth
+  pos_t j = bwd_search(st, i, 0);
+  if(j < -1)
     return -1;
 
-  return fwd_search(st, i);
+  return find_open(st, j+1);
 }
 
-int32_t rank_0(rmMt* st, int32_t i) {
-  // Excess value up to the ith position
-  if(i >= st->n)
+pos_t rank_0(rmMt* st, pos_t i) {
+  if(i < 0) // P[0,i] is empty
+    return 0;
+  if(i >= (pos_t)st->n)
     i = st->n-1;
-    int32_t d = sum(st, i);
-  
-  return (i+1-d)/2;
+
+  return i+1-rank_ones(st, i);
 }
 
-int32_t rank_1(rmMt* st, int32_t i) {
-    // Excess value up to the ith position 
-  if(i >= st->n)
+pos_t rank_1(rmMt* st, pos_t i) {
+  if(i < 0) // P[0,i] is empty
+    return 0;
+  if(i >= (pos_t)st->n)
     i = st->n-1;
-  int32_t d = sum(st, i);
-  
-  return (i+1+d)/2;
+
+  return rank_ones(st, i);
+}
+
+
+// Position of the one with rank r (counting from 0) in the word w
+static inline unsigned int select_in_word(word_t w, unsigned int r) {
+#if defined(__BMI2__) && defined(ARCH64)
+  return __builtin_ctzll(_pdep_u64((uint64_t)1 << r, w));
+#else
+  // Broadword: byte i of c is the number of ones in the bytes 0..i of w. The
+  // byte of the answer is the number of bytes whose count is <= r
+  const uint64_t L8 = 0x0101010101010101ULL, H8 = 0x8080808080808080ULL;
+  uint64_t x = w;
+  uint64_t c = x - ((x >> 1) & 0x5555555555555555ULL);
+  c = (c & 0x3333333333333333ULL) + ((c >> 2) & 0x3333333333333333ULL);
+  c = ((c + (c >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * L8;
+  unsigned int place = __builtin_popcountll((((r*L8) | H8) - c) & H8) * 8;
+  r -= ((c << 8) >> place) & 0xFF;
+
+  uint8_t byte = x >> place;
+  for(; r; r--)
+    byte &= byte-1; // Remove the lowest one
+  return place + __builtin_ctz(byte);
+#endif
 }
 
+/*
+ * Position of the (i+1)-th one (bit = 1) or zero (bit = 0). The sample of i
+ * and the next one bound the blocks that contain the answer. The block is
+ * found by binary search over the rank directory and the position inside the
+ * block by popcount and select_in_word
+ */
+static inline pos_t select_bit(rmMt* st, bit_index_t i, int bit,
+				bit_index_t from) {
+  bit_index_t total = bit ? st->ones : st->n - st->ones;
+  bit_index_t* samples = bit ? st->select1_s : st->select0_s;
+  bit_index_t num_blocks = ((st->n-1) >> RANK_B_LOG) + 1;
 
-int32_t check_chunk(rmMt* st, int32_t i, int32_t d) {
-  int llimit = i;
-  int rlimit = i+st->s;
-  int32_t output;
-  int32_t excess = st->e_prime[(i-1)/st->s];
-  int32_t j = 0;
+  if(i >= total)
+    return -1;
 
-  //  printf("i: %u, llimit: %u, rlimit: %u\n", i, llimit, rlimit);
-   
-  for(j=llimit; j<rlimit; j+=8) {
-    int32_t desired = d - 1 - excess; // desired value must belongs to the range [-8,8]  
-    //    printf("d: %d, desired: %u, current: %u\n", d, desired, excess);
-    
-#ifdef ARCH64
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFFL<<(j&(word_size-1)))) >> (j&(word_size-1));
+  bit_index_t k = i >> SELECT_LOG;
+  bit_index_t lo = max(samples[k], from); // from: a block known to be <= answer
+  bit_index_t hi = (k < ((total-1) >> SELECT_LOG)) ? samples[k+1] : num_blocks-1;
+
+#define BLOCK_RANK(b) (bit ? block_rank(st, b) : \
+		       ((b) << RANK_B_LOG) - block_rank(st, b))
+  while(lo < hi) {
+    bit_index_t mid = lo + (hi-lo+1)/2;
+    if(BLOCK_RANK(mid) <= i)
+      lo = mid;
+    else
+      hi = mid-1;
+  }
+  i -= BLOCK_RANK(lo);
+#undef BLOCK_RANK
+
+  for(word_addr_t w = lo*RANK_B_WORDS; ; w++) {
+    word_t x = bit ? st_word(st, w) : ~st_word(st, w);
+    unsigned int c = popcount_word(x);
+    if(i < c)
+      return w*word_size + select_in_word(x, i);
+    i -= c;
+  }
+}
+
+pos_t select_0(rmMt* st, pos_t i){
+  if(i < 1)
+    return -1;
+
+  return select_bit(st, i-1, 0, 0);
+}
+
+pos_t select_1(rmMt* st, pos_t i){
+  if(i < 1)
+    return -1;
+
+  return select_bit(st, i-1, 1, 0);
+}
+
+/*
+ * Interleaved queries. Each fwd_search stalls on a chain of dependent cache
+ * misses: the rank directory and the words of i, one group of siblings per
+ * level of the min-max tree, and the words of the last chunk. Here a group of
+ * INTERLEAVE_G independent queries is run as state machines in round robin.
+ * Each step of a query prefetches the data of its next step, so the misses of
+ * the queries of the group overlap instead of being served one at a time
+ */
+#define INTERLEAVE_G 16
+
+enum fwd_state { FWD_CHUNK, FWD_UP, FWD_DOWN, FWD_SCAN, FWD_PIONEER };
+
+typedef struct {
+  enum fwd_state state;
+  pos_t i; // Position of the query
+  pos_t d; // Desired excess value (relative to excess(i) before FWD_CHUNK)
+  long node; // Current node of the min-max tree
+  bit_index_t k; // Index of the answer
+  int close; // find_close query, which can use the pioneers
+} fwd_query;
+
+// Prefetch the cache lines of [p,q]
+static inline void prefetch_range(const void* p, const void* q) {
+  uintptr_t a = (uintptr_t)p & ~(uintptr_t)(CACHE_LINE-1);
+  for(; a <= (uintptr_t)q; a += CACHE_LINE)
+    __builtin_prefetch((const void*)a);
+}
+
+// Prefetch what node_contains reads for the siblings [lo,hi]. Siblings are
+// either all internal nodes or all leaves
+static inline void prefetch_nodes(rmMt* st, long lo, long hi) {
+  hi = min(hi, (long)(st->internal_nodes + st->num_chunks) - 1);
+  if(lo > hi)
+    return;
+
+  if(lo < (long)st->internal_nodes) {
+    prefetch_range(&st->nodes[lo], &st->nodes[hi]);
+    return;
+  }
+
+  bit_index_t c_lo = lo - st->internal_nodes, c_hi = hi - st->internal_nodes;
+#ifdef RMMT_BLOCKS
+  prefetch_range(&st->blocks[c_lo], &st->blocks[c_hi]);
 #else
-    int32_t sum_idx = (((st->B)->words[j>>logW]) & (0xFF<<(j&(word_size-1)))) >> (j&(word_size-1));
+  if(c_lo > 0)
+    c_lo--; // excess_before(c) reads the leaf c-1
+  prefetch_range(&st->leaves[c_lo], &st->leaves[c_hi]);
+  __builtin_prefetch(&st->e_sample[(c_lo*RMMT_S) >> E_SAMPLE_LOG]);
 #endif
-    
-    if (desired >= -8 && desired <= 8) {
-      uint16_t ii = (desired+8<<8) + sum_idx;
-      
-      int8_t x = T->near_fwd_pos[ii];
-      //    printf("sum_idx: %u, ii: %d, x: %d\n", sum_idx, ii, x);
-      if(x < 8)
-	return j+x;
+}
+
+// Prefetch what sum(i) and the scan of the chunk of i read
+static inline void prefetch_position(rmMt* st, bit_index_t i) {
+#ifdef RMMT_BLOCKS
+  __builtin_prefetch(&st->blocks[i / RMMT_S]);
+#else
+  __builtin_prefetch(&st->rank_b[i >> RANK_B_LOG]);
+  prefetch_range(st_words(st, (i >> RANK_B_LOG)*RANK_B_WORDS),
+		 st_words(st, i >> logW));
+#endif
+}
+
+// The query x continues at node, which contains its answer
+static inline void fwd_descend(rmMt* st, fwd_query* x, long node) {
+  if(is_leaf(node, st)) {
+    bit_index_t chunk = node - st->internal_nodes;
+    prefetch_range(st_words(st, (chunk*RMMT_S) >> logW),
+		   st_words(st, (min((chunk+1)*RMMT_S, st->n)-1) >> logW));
+    x->state = FWD_SCAN;
+  }
+  else {
+    prefetch_nodes(st, first_child(node), last_child(node));
+    x->state = FWD_DOWN;
+  }
+  x->node = node;
+}
+
+// One step of the query x. It returns 1 when the answer (*ans) is known
+static int fwd_step(rmMt* st, fwd_query* x, pos_t* ans) {
+  bit_index_t chunk;
+  long node = x->node;
+
+  switch(x->state) {
+  case FWD_CHUNK: // Case 1 of fwd_search: the chunk of i
+    {
+      pos_t e = sum(st, x->i);
+      x->d += e;
+      chunk = x->i / RMMT_S;
+      *ans = fwd_scan(st, x->i+1, min((chunk+1)*RMMT_S, st->n), e, x->d);
+      node = st->internal_nodes + chunk;
+      if(*ans >= 0 || is_root(node))
+	return 1;
+      prefetch_nodes(st, node+1, last_sibling(node));
+      if(x->close && st->pioneer_first != NULL) {
+	// The pioneers replace the climb of the min-max tree
+	__builtin_prefetch(&st->pioneer_sb[chunk/PIONEER_SB_CHUNKS]);
+	prefetch_range(&st->pioneer_first[chunk], &st->pioneer_first[chunk+1]);
+	x->state = FWD_PIONEER;
+	return 0;
+      }
+      x->state = FWD_UP;
+      break;
     }
-    excess += T->word_sum[sum_idx];
-  } 
-    
-  return i-1;
+  case FWD_UP: // Case 2: the right siblings of the node, or go up
+    {
+      long last = last_sibling(node);
+      while(node < last)
+	if(node_contains(st, ++node, x->d)) {
+	  fwd_descend(st, x, node);
+	  return 0;
+	}
+      node = parent(node);
+      if(is_root(node)) {
+	*ans = -1;
+	return 1;
+      }
+      prefetch_nodes(st, node+1, last_sibling(node));
+      break;
+    }
+  case FWD_DOWN: // One level down, to the leftmost child that contains d
+    node = first_child(node);
+    while(!node_contains(st, node, x->d))
+      node++;
+    fwd_descend(st, x, node);
+    return 0;
+  case FWD_SCAN: // The chunk of the answer
+    chunk = node - st->internal_nodes;
+    *ans = fwd_scan(st, chunk*RMMT_S, min((chunk+1)*RMMT_S, st->n),
+		    excess_before(st, chunk), x->d);
+    return 1;
+  case FWD_PIONEER: // find_close of a far parenthesis (see find_close_e)
+    {
+      pos_t before;
+      chunk = far_match(st, x->i, x->d+1, &before);
+      *ans = (chunk == st->num_chunks) ? -1 :
+	fwd_scan(st, chunk*RMMT_S, min((chunk+1)*RMMT_S, st->n), before, x->d);
+      return 1;
+    }
+  }
+
+  x->node = node;
+  return 0;
 }
 
-// ToDo: Implement it more efficiently
-int32_t select_0(rmMt* st, int32_t i){
+// out[k] = fwd_search(st, q[k], d[k]), or find_close(st, q[k]) if d is NULL
+static void fwd_interleaved(rmMt* st, const pos_t* q, const pos_t* d,
+			    pos_t* out, bit_index_t m) {
+  fwd_query group[INTERLEAVE_G];
+  unsigned int active = 0;
+  bit_index_t next = 0;
+
+  for(;;) {
+    // Fill the free slots of the group with new queries
+    while(active < INTERLEAVE_G && next < m) {
+      bit_index_t k = next++;
+      pos_t i = q[k];
+      if(d == NULL && (i < 0 || i >= (pos_t)st->n)) {
+	out[k] = -1;
+	continue;
+      }
+      prefetch_position(st, i);
+      group[active++] = (fwd_query){FWD_CHUNK, i, d ? d[k] : -1, 0, k,
+				    d == NULL};
+    }
+    if(active == 0)
+      break;
+
+    for(unsigned int g = 0; g < active; ) {
+      fwd_query* x = &group[g];
+      pos_t ans;
+      // find_close of a closing parenthesis
+      if(d == NULL && x->state == FWD_CHUNK && st_get_bit(st, x->i) == 0)
+	ans = -1;
+      else if(!fwd_step(st, x, &ans)) {
+	g++;
+	continue;
+      }
+      out[x->k] = ans;
+      *x = group[--active]; // The last query takes the slot
+    }
+  }
+}
 
-  int32_t j = 0;
+/*
+ * Batched queries. The queries are split in parts of 2^BATCH_LOG that are
+ * answered in parallel. Inside a part, the queries are visited in increasing
+ * order of chunk (of rank for select), sorted with a radix sort unless they are
+ * already in order. Unsorted find_close queries are not sorted but run
+ * interleaved (see fwd_interleaved). In order:
+ * - find_close obtains the excess value of a query from the excess value
+ *   before its chunk, which is computed once per chunk, plus a popcount
+ * - select starts the binary search at the block of the previous answer
+ * - All of them visit the sequence in order, so consecutive queries share
+ *   cache lines
+ */
+#define BATCH_LOG 14
 
-  // The answer is after the position 2*i-1
-  int32_t excess = sum(st,2*i-1);
+enum batch_op { BATCH_FIND_CLOSE, BATCH_RANK0, BATCH_RANK1, BATCH_SELECT0,
+		BATCH_SELECT1 };
 
-  // Note: The answer is not beyond the position 2*i-1+depth_max, where
-  // depth_max is the maximal depth (excess) of the input tree
-  int32_t llimit = 2*i-1;
-  int32_t rlimit = llimit + st->M_prime[0];
-  int32_t d = 0;
+// Radix sort of the items (key << BATCH_LOG | query) of a part by key, using
+// tmp[] as buffer. The keys have at most key_bits bits
+static void sort_items(uint64_t* items, uint64_t* tmp, uint32_t len,
+		       unsigned int key_bits) {
+  uint32_t count[257];
 
-  for (j=llimit+1; j <=rlimit; ++j,++d) {
-    if (excess == d)
-      return j-1;
-    excess += 2*bit_array_get_bit(st->B,j)-1;
+  for(unsigned int shift = BATCH_LOG; shift < BATCH_LOG + key_bits; shift += 8) {
+    memset(count, 0, sizeof(count));
+    for(uint32_t k = 0; k < len; k++)
+      count[((items[k] >> shift) & 0xFF) + 1]++;
+    for(unsigned int b = 1; b < 257; b++)
+      count[b] += count[b-1];
+    for(uint32_t k = 0; k < len; k++)
+      tmp[count[(items[k] >> shift) & 0xFF]++] = items[k];
+    memcpy(items, tmp, len*sizeof(uint64_t));
   }
+}
 
-    return -1;
+// Excess value up to the position i of the chunk c, where e is the excess
+// value before the chunk
+static inline pos_t chunk_sum(rmMt* st, bit_index_t c, pos_t e, bit_index_t i) {
+  bit_index_t ones = 0;
+  word_addr_t w = (c*RMMT_S) >> logW, last = i >> logW;
+
+  for(; w < last; w++)
+    ones += popcount_word(st_word(st, w));
+  ones += popcount_word(st_word(st, last) &
+			(~(word_t)0 >> (word_size-1-(i&(word_size-1)))));
+
+  return e + 2*(pos_t)ones - (pos_t)(i+1 - c*RMMT_S);
 }
 
-// ToDo: Implement it more efficiently
-int32_t select_1(rmMt* st, int32_t i){
-  int32_t j = 0;
+// Data shared by the parts of batch_queries
+struct batch_args {
+  rmMt* st;
+  const pos_t* q;
+  pos_t* out;
+  bit_index_t m;
+  enum batch_op op;
+  int by_rank;
+  unsigned int key_bits;
+};
 
-  // Note: The answer is in the range [0,2*i-1] not beyond the position 2*i-1
-  int32_t excess = 0;
-  int32_t llimit = 0;
-  int32_t rlimit = 2*i-1;
-  int32_t d = 2*i-1;
+// Queries of the part
+static void batch_part(long i, void* arg) {
+  struct batch_args* a = arg;
+  rmMt* st = a->st;
+  const pos_t* q = a->q;
+  pos_t* out = a->out;
+  bit_index_t m = a->m;
+  enum batch_op op = a->op;
+  int by_rank = a->by_rank;
+  unsigned int key_bits = a->key_bits;
+  bit_index_t part = i;
 
-  for (j=llimit; j <=rlimit; ++j,--d) {
-    excess += 2*bit_array_get_bit(st->B,j)-1;
-    if (excess == d)
-      return j;
+  bit_index_t first = part << BATCH_LOG;
+  uint32_t len = min(m - first, (bit_index_t)1 << BATCH_LOG);
+  const pos_t* pq = q + first;
+  pos_t* pout = out + first;
+
+  // Queries with their keys. Invalid queries get the key 0
+  uint64_t* items = (uint64_t*)malloc(2*len*sizeof(uint64_t));
+  int sorted = 1;
+  for(uint32_t k = 0; k < len; k++) {
+    pos_t x = pq[k];
+    uint64_t key;
+    if(by_rank)
+      key = (x >= 1 && x <= (pos_t)st->n) ? x : 0;
+    else
+      key = (x >= 0 && x < (pos_t)st->n) ? x / RMMT_S : 0;
+    items[k] = (key << BATCH_LOG) | k;
+    if(k && items[k] < items[k-1])
+      sorted = 0;
   }
 
-    return -1;
+  // Unsorted find_close queries are answered interleaved instead, which
+  // hides more latency than sorting them
+  int interleave = !sorted && op == BATCH_FIND_CLOSE;
+  if(interleave)
+    fwd_interleaved(st, pq, NULL, pout, len);
+  else if(!sorted)
+    sort_items(items, items + len, len, key_bits);
+
+  bit_index_t chunk = st->num_chunks; // Chunk of the excess value e
+  pos_t e = 0;
+  bit_index_t from[2] = {0, 0}; // Block of the last answer of select_0/1
+  for(uint32_t k = 0; !interleave && k < len; k++) {
+    uint32_t idx = items[k] & ((1 << BATCH_LOG) - 1);
+    bit_index_t key = items[k] >> BATCH_LOG;
+    pos_t x = pq[idx], ans = -1;
+
+    switch(op) {
+    case BATCH_FIND_CLOSE:
+      if(x >= 0 && x < (pos_t)st->n && st_get_bit(st, x)) {
+	if(key != chunk) {
+	  chunk = key;
+	  e = excess_before(st, chunk);
+	}
+	ans = find_close_e(st, x, chunk_sum(st, chunk, e, x));
+      }
+      break;
+    case BATCH_RANK0:
+      ans = rank_0(st, x);
+      break;
+    case BATCH_RANK1:
+      ans = rank_1(st, x);
+      break;
+    case BATCH_SELECT0:
+    case BATCH_SELECT1:
+      if(x >= 1) {
+	int bit = (op == BATCH_SELECT1);
+	ans = select_bit(st, x-1, bit, from[bit]);
+	if(ans >= 0)
+	  from[bit] = ans >> RANK_B_LOG;
+      }
+      break;
+    }
+    pout[idx] = ans;
+  }
+
+  free(items);
+}
+
+static void batch_queries(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m,
+			  enum batch_op op) {
+  int by_rank = (op == BATCH_SELECT0 || op == BATCH_SELECT1);
+  bit_index_t max_key = by_rank ? st->n : st->num_chunks;
+  unsigned int key_bits = 64 - __builtin_clzll((unsigned long long)max_key | 1);
+  bit_index_t num_parts = (m + (1 << BATCH_LOG) - 1) >> BATCH_LOG;
+
+  struct batch_args a = {st, q, out, m, op, by_rank, key_bits};
+  parallel_for(0, num_parts, batch_part, &a);
+}
+
+void find_close_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m) {
+  batch_queries(st, q, out, m, BATCH_FIND_CLOSE);
+}
+
+void rank_0_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m) {
+  batch_queries(st, q, out, m, BATCH_RANK0);
+}
+
+void rank_1_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m) {
+  batch_queries(st, q, out, m, BATCH_RANK1);
+}
+
+void select_0_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m) {
+  batch_queries(st, q, out, m, BATCH_SELECT0);
+}
+
+void select_1_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m) {
+  batch_queries(st, q, out, m, BATCH_SELECT1);
+}
+
+void fwd_search_interleaved(rmMt* st, const pos_t* i, const pos_t* d,
+			    pos_t* out, bit_index_t m) {
+  fwd_interleaved(st, i, d, out, m);
+}
+
+void find_close_interleaved(rmMt* st, const pos_t* q, pos_t* out,
+			    bit_index_t m) {
+  fwd_interleaved(st, q, NULL, out, m);
 }
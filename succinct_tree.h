@@ -33,29 +33,160 @@
 
 #include "lookup_tables.h"
 
+/*
+ * Chunk size (in bits) and arity of the range min-max tree. They are fixed at
+ * compile time, e.g. -DRMMT_S=512 -DRMMT_K=8. The chunk size must be a power
+ * of two in [64,2^14], so chunks start at word boundaries and the excess
+ * values relative to a chunk fit in 16 bits
+ *
+ * With -DRMMT_BLOCKS the bits are not kept in the input BIT_ARRAY. Each chunk
+ * is stored in a 64-byte block together with the excess values of its leaf
+ * (see rmM_block), so scanning a chunk and checking its leaf read a single
+ * cache line. The chunk size is then the payload of a block: 448 bits (384
+ * with IDX64)
+ */
+#ifdef RMMT_BLOCKS
+#ifdef RMMT_S
+#error "RMMT_S is fixed by the block size with RMMT_BLOCKS"
+#endif
+#ifdef IDX64
+#define RMMT_S 384
+#else
+#define RMMT_S 448
+#endif
+#endif
+
+#ifndef RMMT_S
+#define RMMT_S 256
+#endif
+
+// The default arity fills a cache line with the children of a node (see
+// mM_node)
+#ifndef RMMT_K
+#ifdef IDX64
+#define RMMT_K 4
+#else
+#define RMMT_K 8
+#endif
+#endif
+
+#if !defined(RMMT_BLOCKS) && ((RMMT_S & (RMMT_S-1)) || RMMT_S < 64 || RMMT_S > (1 << 14))
+#error "RMMT_S must be a power of two in [64,16384]"
+#endif
+
+#if RMMT_K < 2
+#error "RMMT_K must be at least 2"
+#endif
+
+// Positions and excess values used by the operations. They have the width of
+// bit_index_t (see IDX64). Operations return -1 when there is no answer
+#ifdef IDX64
+typedef int64_t pos_t;
+#else
+typedef int32_t pos_t;
+#endif
+
+// Minimum and maximum excess values of an internal node of the min-max tree,
+// stored together since the searches always read both
+typedef struct {
+  pos_t m;
+  pos_t M;
+} mM_node;
+
+// Excess values of a leaf (chunk) of the min-max tree
+typedef struct {
+  int16_t e; // Excess at the end of the chunk, relative to its sample
+  int16_t m; // Minimum, relative to the excess before the chunk
+  int16_t M; // Maximum, relative to the excess before the chunk
+} mM_leaf;
+
+#ifdef RMMT_BLOCKS
+#define RMMT_WORDS (RMMT_S/(word_size)) // Words per block
+
+// A chunk of bits and the excess values of its leaf, in one cache line
+typedef struct {
+  pos_t e; // Excess value before the chunk
+  int16_t m; // Minimum, relative to e
+  int16_t M; // Maximum, relative to e
+  word_t bits[RMMT_WORDS];
+} __attribute__((aligned(64))) rmM_block;
+#endif
+
+// An opening parenthesis is far if its match is not in its chunk. The first
+// far parenthesis of a chunk is a pioneer, and so is each far parenthesis whose
+// match is in a different chunk than the match of the previous far parenthesis
+// of its chunk. Only the pioneers whose match is beyond the right siblings of
+// the leaf of its chunk (or beyond the next chunk) are kept
+typedef struct {
+  uint16_t off; // Offset in its chunk
+  bit_index_t chunk; // Chunk of the match (num_chunks if it has no match)
+  pos_t e; // Excess value before the chunk of the match
+} pioneer;
+
 struct rmMt_t {
   unsigned int s; // Chunk size
   unsigned int k; // arity of the min-max tree
   unsigned long n; // number of parentheses
   unsigned int height;
-  unsigned int internal_nodes; // Number of internal nodes
-#ifdef ARCH64
-  unsigned long num_chunks;
+  bit_index_t internal_nodes; // Number of internal nodes
+  bit_index_t num_chunks;
+#ifdef RMMT_BLOCKS
+  rmM_block* blocks; // num_chunks blocks, with the bits and the leaves
+  rmM_block* blocks_mem; // Allocation that contains blocks
 #else
-  unsigned int num_chunks;
+  // Excess values. The leaves keep 16-bit values relative to an absolute
+  // sample, so they do not overflow in deep trees:
+  // - excess at the end of the chunk c: e_sample[c*s >> 14] + leaves[c].e
+  // - minimum (maximum) of the chunk c: excess at the end of the chunk c-1
+  //   plus leaves[c].m (leaves[c].M)
+  // The internal nodes keep absolute values. They are in heap order, but the
+  // array is shifted so the children of each node start at a cache line
+  // boundary. With the default arity a root-to-leaf path reads one cache line
+  // per level (a B-tree layout)
+  pos_t* e_sample; // Excess value before each 2^14 bits
+  mM_leaf* leaves; // num_chunks leaves
 #endif
-  int16_t* e_prime; // num_chunks leaves (it does not need internal nodes)
-  int16_t* m_prime; // num_chunks leaves plus internal nodes
-  int16_t* M_prime; // num_chunks leaves plus internal nodes
+  mM_node* nodes; // internal nodes
+  mM_node* nodes_mem; // Allocation that contains nodes
 
-  // Input bitarray
+  // Rank directory. rank_sb[i] is the number of ones before the i-th
+  // superblock and rank_b[j] is the number of ones before the j-th block,
+  // counted from the beginning of its superblock
+  bit_index_t* rank_sb;
+  uint16_t* rank_b;
+  bit_index_t ones; // Number of ones in B
+
+  // Select samples. select1_s[k] (select0_s[k]) is the block that contains
+  // the one (zero) with rank k*2^12, counting from 0
+  bit_index_t* select1_s;
+  bit_index_t* select0_s;
+
+  // Pioneers (optional, see st_build_pioneers). As in the rank directory, the
+  // pioneers of a chunk start at the entry given by its superblock (pioneer_sb,
+  // about 2^16 bits) plus a 16-bit count (pioneer_first). NULL if they are not
+  // built
+  bit_index_t* pioneer_sb;
+  uint16_t* pioneer_first;
+  pioneer* pioneers;
+
+  // Input bitarray (NULL with RMMT_BLOCKS, it is released by the construction)
   BIT_ARRAY* B;
 };
 
 typedef struct rmMt_t rmMt;
 
-lookup_table *T;
-unsigned int height;
+// The word w and the bit i of the sequence
+static inline word_t st_word(rmMt* st, word_addr_t w) {
+#ifdef RMMT_BLOCKS
+  return st->blocks[w / RMMT_WORDS].bits[w % RMMT_WORDS];
+#else
+  return st->B->words[w];
+#endif
+}
+
+static inline int st_get_bit(rmMt* st, bit_index_t i) {
+  return (st_word(st, i/(word_size)) >> (i%(word_size))) & 1;
+}
 
 /* Construction */
 
@@ -64,45 +195,112 @@ void st_create(BIT_ARRAY* B, unsigned long n);
 rmMt* st_create_emM(BIT_ARRAY* B, unsigned long n);
 rmMt* st_create_il(BIT_ARRAY* B, unsigned long n);
 
+// It adds the pioneers to st, so find_close (also the batched and interleaved
+// versions) answers the parentheses whose match is far in constant time: the
+// chunk of the match is read from the pioneer that precedes i, instead of
+// walking the min-max tree. They take O(n/s) words and pay off in sequences
+// with many long-range matches
+void st_build_pioneers(rmMt* st);
+
 void print_rmMt(rmMt*);
 
 /* Operations */
 
 // It returns the position of the closing parenthesis that matches the openning
 // parenthesis at position i. It is defined in the paper of Navarro and Sadakane
-int32_t find_close(rmMt* st, int32_t i);
+pos_t find_close(rmMt* st, pos_t i);
 
-// Implementation of the primitive operation fwd_search(P,\pi,i,d)
+// It returns the position of the opening parenthesis that matches the closing
+// parenthesis at position i
+pos_t find_open(rmMt* st, pos_t i);
+
+// It returns the position of the opening parenthesis of the tightest pair that
+// encloses the parenthesis at position i (the parent node), or -1 at the root
+pos_t enclose(rmMt* st, pos_t i);
+
+// Implementation of the primitive operation fwd_search(P,\pi,i,d), the
+// smallest j > i such that sum(P,\pi,0,j) = sum(P,\pi,0,i) + d
 // It is defined in the paper of Navarro and Sadakane
-int32_t fwd_search(rmMt* st, int32_t i);
+pos_t fwd_search(rmMt* st, pos_t i, pos_t d);
+
+// Implementation of the primitive operation bwd_search(P,\pi,i,d), the
+// largest j < i such that sum(P,\pi,0,j) = sum(P,\pi,0,i) + d. The position
+// j = -1 (empty prefix, excess 0) is a valid answer, so it returns -2 when
+// there is no answer
+pos_t bwd_search(rmMt* st, pos_t i, pos_t d);
 
 // Implementation of the primitive operation sum(P,\pi,i,j)
 // It is defined in the paper of Navarro and Sadakane
 // It is equivalent to the depth of the ith node or the excess value at ith position
-int32_t sum(rmMt* st, int32_t i);
+pos_t sum(rmMt* st, pos_t i);
 
-// Implementation of the operation rank_{0}(P,i)
-// It is defined in the paper of Navarro and Sadakane
-// To implement it, we use the following corollary:
-// rank_{0}(P,i) = (i+1-sum(P,\pi,0,i))/2
-int32_t rank_0(rmMt* st, int32_t i);
+// It returns the minimum excess value in P[i,j]
+pos_t rmq(rmMt* st, pos_t i, pos_t j);
 
-// Implementation of the operation rank_{1}(P,i)
-// It is defined in the paper of Navarro and Sadakane
-// To implement it, we use the following corollary:
-// rank_{1}(P,i) = (i+1+sum(P,\pi,0,i))/2
-int32_t rank_1(rmMt* st, int32_t i);
+// It returns the position of the rightmost minimum excess value in P[i,j]
+pos_t rmqi(rmMt* st, pos_t i, pos_t j);
 
-// Implementation of the operation select_{0}(P,i)
-// It is defined in the paper of Navarro and Sadakane
-// To implement it, we use the following corollary:
-// select_{0}(P,i) = min{j|j \ge 0, sum(P,\pi,0,j) = j+1-2i}
-int32_t select_0(rmMt* st, int32_t i);
+// It returns the lowest common ancestor of the nodes whose opening parentheses
+// are at positions i and j
+pos_t lca(rmMt* st, pos_t i, pos_t j);
 
-// Implementation of the operation select_{1}(P,i)
-// It is defined in the paper of Navarro and Sadakane
-// To implement it, we use the following corollary:
-// select_{1}(P,i) = min{j|j \ge 0, sum(P,\pi,0,j) = 2i-j-1}
-int32_t select_1(rmMt* st, int32_t i);
+// It returns the number of nodes in the subtree of the node at position i
+pos_t subtree_size(rmMt* st, pos_t i);
+
+// It returns the depth of the node at position i (1 for the root)
+pos_t depth(rmMt* st, pos_t i);
+
+// It returns the ancestor d levels above the node at position i (the node
+// itself for d = 0), or -1 if there is no such ancestor
+pos_t level_ancestor(rmMt* st, pos_t i, pos_t d);
+
+// It returns the next node (in preorder) with the same depth as the node at
+// position i, or -1 if there is no such node
+pos_t level_next(rmMt* st, pos_t i);
+
+// It returns the previous node (in preorder) with the same depth as the node
+// at position i, or -1 if there is no such node
+pos_t level_prev(rmMt* st, pos_t i);
+
+// Implementation of the operation rank_{0}(P,i), the number of zeros in
+// P[0,i]. It is computed as i+1-rank_{1}(P,i). It returns 0 if i < 0, and
+// the number of zeros in P if i >= n
+pos_t rank_0(rmMt* st, pos_t i);
+
+// Implementation of the operation rank_{1}(P,i), the number of ones in
+// P[0,i]. It uses the rank directory and popcount over at most one block. It
+// returns 0 if i < 0, and the number of ones in P if i >= n
+pos_t rank_1(rmMt* st, pos_t i);
+
+// Implementation of the operation select_{0}(P,i), the position of the i-th
+// zero of P (i >= 1). It returns -1 if there is no such zero
+pos_t select_0(rmMt* st, pos_t i);
+
+// Implementation of the operation select_{1}(P,i), the position of the i-th
+// one of P (i >= 1). It returns -1 if there is no such one
+pos_t select_1(rmMt* st, pos_t i);
+
+/* Batched operations */
+
+// out[k] is the answer of the operation for q[k], 0 <= k < m. The queries are
+// answered in parallel, grouped by chunk (by rank for select) so that
+// consecutive queries reuse excess values and cache lines. Sorted queries
+// avoid the internal sort (unsorted find_close queries are run interleaved, as
+// in find_close_interleaved)
+void find_close_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m);
+void rank_0_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m);
+void rank_1_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m);
+void select_0_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m);
+void select_1_batch(rmMt* st, const pos_t* q, pos_t* out, bit_index_t m);
+
+// out[k] = fwd_search(st, i[k], d[k]) (find_close(st, q[k])), 0 <= k < m, on a
+// single thread. Groups of queries are run interleaved, prefetching the nodes
+// and words of each query before reading them, so the cache misses of
+// different queries overlap. It pays off when the tree does not fit in the
+// cache. The positions i[k] must be valid
+void fwd_search_interleaved(rmMt* st, const pos_t* i, const pos_t* d,
+			    pos_t* out, bit_index_t m);
+void find_close_interleaved(rmMt* st, const pos_t* q, pos_t* out,
+			    bit_index_t m);
 
 #endif // SUCCINCT_TREE_H
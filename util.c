@@ -32,6 +32,9 @@
 
 #include "util.h"
 
+// Indices may not fit in an int (see IDX64 in defs.h)
+#define parse_idx(str) ((idx_t)strtoul((str), NULL, 10))
+
 // Assuming that the indices of the vertices are contiguous
 Graph* read_graph_from_file(const char* fn) {
   Graph *g = malloc(sizeof(Graph));
@@ -50,23 +53,23 @@ Graph* read_graph_from_file(const char* fn) {
     exit(EXIT_FAILURE);
   }
 
-  g->n = atoi(fgets(line_buffer, sizeof(line_buffer), fp));
-  g->m = atoi(fgets(line_buffer, sizeof(line_buffer), fp));
+  g->n = parse_idx(fgets(line_buffer, sizeof(line_buffer), fp));
+  g->m = parse_idx(fgets(line_buffer, sizeof(line_buffer), fp));
 
   g->V = calloc(g->n,sizeof(Vertex));
   g->E = calloc(2*(g->m),sizeof(Edge));
 
-  uint source = 0, m = 0;
+  idx_t source = 0, m = 0;
   char *target;
 
   while (fgets(line_buffer, sizeof(line_buffer), fp)) {
-    source = atoi(strtok(line_buffer, " "));
+    source = parse_idx(strtok(line_buffer, " "));
     g->V[source].first = m;
     target = strtok(NULL, " ");
 
     while (target != NULL && strcmp(target,"\n")!=0){
       g->E[m].src = source;
-      g->E[m].tgt = atoi(target);
+      g->E[m].tgt = parse_idx(target);
       //      g->E[m].p_src = m; // This can be omitted
       target = strtok(NULL, " ");
       m++;
@@ -80,7 +83,7 @@ Graph* read_graph_from_file(const char* fn) {
     the source and target vertices.
    */
 
-  uint i = 0, j = 0;
+  idx_t i = 0, j = 0;
 
   for(i = 0; i < 2*g->m; i++) {
     Vertex targetV = g->V[g->E[i].tgt];
@@ -96,8 +99,8 @@ Graph* read_graph_from_file(const char* fn) {
   return g;
 }
 
-uint* read_canonical_ordering_from_file(const char* fn, uint n) {
-  uint* co = calloc(n, sizeof(uint));
+idx_t* read_canonical_ordering_from_file(const char* fn, idx_t n) {
+  idx_t* co = calloc(n, sizeof(idx_t));
 
   FILE *fp = fopen(fn, "r");;
   char line_buffer[BUFSIZ]; /* BUFSIZ is defined if you include stdio.h */
@@ -109,10 +112,10 @@ uint* read_canonical_ordering_from_file(const char* fn, uint n) {
 
  fgets(line_buffer, sizeof(line_buffer), fp);
 
-  uint vertex = 0, order = 0;
+  idx_t vertex = 0, order = 0;
   while (fgets(line_buffer, sizeof(line_buffer), fp)) {
-    vertex = atoi(strtok(line_buffer, " "));
-    order = atoi(strtok(NULL, " "));
+    vertex = parse_idx(strtok(line_buffer, " "));
+    order = parse_idx(strtok(NULL, " "));
     co[vertex] = order;
   }
 
@@ -129,19 +132,22 @@ void* write_graph_to_file(const char* fn, Graph* g) {
     exit(EXIT_FAILURE);
   }
 
-  uint i = 0, j = 0;
+  idx_t i = 0, j = 0;
 
-  fprintf(fp, "%u\n", g->n);
-  fprintf(fp, "%u\n", g->m);
+  fprintf(fp, "%lu\n", (unsigned long)g->n);
+  fprintf(fp, "%lu\n", (unsigned long)g->m);
 
   for(i = 0; i < g->n; i++) {
-    fprintf(fp, "%u ", i);
+    fprintf(fp, "%lu ", (unsigned long)i);
     Vertex v = vertex(g,i);
     for(j = firstE(v); j <= lastE(v)-1; j++) {
-      fprintf(fp, "%u ", pTarget(edge(g,j)));
+      fprintf(fp, "%lu ", (unsigned long)pTarget(edge(g,j)));
     }
-    fprintf(fp, "%u\n", pTarget(edge(g,lastE(v))));
+    fprintf(fp, "%lu\n", (unsigned long)pTarget(edge(g,lastE(v))));
   }
+
+  fclose(fp);
+  return NULL;
 }
 
 void* write_tree_to_file(const char* fn, Tree* g) {
@@ -153,19 +159,22 @@ void* write_tree_to_file(const char* fn, Tree* g) {
     exit(EXIT_FAILURE);
   }
 
-  uint i = 0, j = 0;
+  idx_t i = 0, j = 0;
 
-  fprintf(fp, "%u\n", g->n);
+  fprintf(fp, "%lu\n", (unsigned long)g->n);
 
   for(i = 0; i < g->n; i++) {
-    fprintf(fp, "%u ", i);
+    fprintf(fp, "%lu ", (unsigned long)i);
     Node v = g->N[i];
     for(j = v.first; j < v.last; j++) {
-      fprintf(fp, "%u ", g->E[j].tgt);
+      fprintf(fp, "%lu ", (unsigned long)g->E[j].tgt);
     }
 
-    fprintf(fp, "%u\n", g->E[v.last].tgt);
+    fprintf(fp, "%lu\n", (unsigned long)g->E[v.last].tgt);
   }
+
+  fclose(fp);
+  return NULL;
 }
 
 // Assuming that the indices of the vertices are contiguous
@@ -200,22 +209,22 @@ Tree* read_tree_from_file(const char* fn) {
     exit(EXIT_FAILURE);
   }
 
-  t->n = atoi(fgets(line_buffer, sizeof(line_buffer), fp));
+  t->n = parse_idx(fgets(line_buffer, sizeof(line_buffer), fp));
 
   t->N = calloc(t->n,sizeof(Node));
   t->E = calloc(2*(t->n-1),sizeof(Edge));
 
-  uint source = 0, m = 0;
+  idx_t source = 0, m = 0;
   char *target;
 
   while (fgets(line_buffer, sizeof(line_buffer), fp)) {
-    source = atoi(strtok(line_buffer, " "));
+    source = parse_idx(strtok(line_buffer, " "));
     t->N[source].first = m;
     target = strtok(NULL, " ");
 
     while (target != NULL && strcmp(target,"\n")!=0){
       t->E[m].src = source;
-      t->E[m].tgt = atoi(target);
+      t->E[m].tgt = parse_idx(target);
       //      g->E[m].p_src = m; // This can be omitted
       target = strtok(NULL, " ");
       m++;
@@ -229,7 +238,7 @@ Tree* read_tree_from_file(const char* fn) {
     the source and target vertices.
    */
 
-  uint i = 0, j = 0;
+  idx_t i = 0, j = 0;
 
   for(i = 0; i < 2*(t->n-1); i++) {
     Node targetV = t->N[t->E[i].tgt];
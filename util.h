@@ -32,7 +32,7 @@ Graph* read_graph_from_file(const char*);
 Tree* read_tree_from_file(const char*);
 void* write_graph_to_file(const char*, Graph*);
 void* write_tree_to_file(const char*, Tree*);
-uint* read_canonical_ordering_from_file(const char*, uint);
+idx_t* read_canonical_ordering_from_file(const char*, idx_t);
 
 void free_graph(Graph*);
 void free_tree(Tree*);